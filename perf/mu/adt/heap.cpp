@@ -0,0 +1,229 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mu/adt/heap.h>
+
+/// Benchmark filling and draining a heap with the following runtime parameters
+///
+/// - total number of elements
+///
+/// Elements count their copies and moves, which are reported per pop along
+/// with the elapsed time for
+///
+/// - copying \c top() and then calling \c pop(), as callers had to before \c
+///   pop_top() was available,
+/// - \c pop_top(), moving the minimum out, and
+/// - a reference swap based pop, as \c mu::alg::heap::pop was implemented
+///   before it moved a hole down the heap.
+///
+/// Heaps of heavyweight elements, \c std::string and \c std::shared_ptr, are
+/// then filled and drained using both \c mu::adt::heap and reference swap
+/// based push and pop implementations.
+
+using namespace std;
+using mu::adt::heap;
+
+/// An element counting its copy and move operations.
+struct counted {
+    static size_t copies_;
+    static size_t moves_;
+
+    static void reset() { copies_ = 0; moves_ = 0; }
+
+    counted() : value_(0) {}
+    counted(size_t value) : value_(value) {}
+    counted(const counted& o) : value_(o.value_) { ++copies_; }
+    counted(counted&& o) : value_(o.value_) { ++moves_; }
+    ~counted() = default;
+
+    counted& operator=(const counted& o)
+    {
+        value_ = o.value_;
+        ++copies_;
+        return *this;
+    }
+
+    counted& operator=(counted&& o)
+    {
+        value_ = o.value_;
+        ++moves_;
+        return *this;
+    }
+
+    bool operator<(const counted& o) const { return value_ < o.value_; }
+
+    size_t value_;
+};
+
+size_t counted::copies_ = 0;
+size_t counted::moves_ = 0;
+
+/// The swap based push that \c mu::alg::heap::bubble_last replaced.
+template <typename T>
+static void swap_push(deque<T>& a, T&& e)
+{
+    a.emplace_back(move(e));
+    size_t i = a.size() - 1;
+    while (i > 0 && a[i] < a[(i - 1) / 2]) {
+        swap(a[i], a[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+}
+
+/// The swap based pop that \c mu::alg::heap::pop replaced.
+template <typename T>
+static void swap_pop(deque<T>& a)
+{
+    swap(a[0], a[a.size() - 1]);
+    a.pop_back();
+    size_t i = 0;
+    while (true) {
+        const size_t l = 2 * i + 1;
+        const size_t r = 2 * i + 2;
+        if (l >= a.size()) {
+            break;
+        }
+        if (r >= a.size()) {
+            if (a[l] < a[i]) {
+                swap(a[l], a[i]);
+            }
+            break;
+        }
+        if (a[i] < a[l] && a[i] < a[r]) {
+            break;
+        }
+        const size_t c = a[l] < a[r] ? l : r;
+        swap(a[c], a[i]);
+        i = c;
+    }
+}
+
+/// Fill a heap with \c n random elements using \c push, drain it with \c pop
+/// and report the operations per pop.
+template <typename Heap, typename Push, typename Pop>
+static void drain(const string& name, size_t n, Push push, Pop pop)
+{
+    mt19937_64 generator(n);
+    Heap h;
+    for (size_t i = 0; i < n; ++i) {
+        push(h, counted(generator()));
+    }
+
+    counted::reset();
+    const auto start = chrono::steady_clock::now();
+    while (!h.empty()) {
+        pop(h);
+    }
+    const auto stop = chrono::steady_clock::now();
+
+    cout << name << " "
+            << chrono::duration_cast<chrono::milliseconds>(stop - start).count()
+            << " ms, "
+            << static_cast<double>(counted::copies_) / n << " copies/pop, "
+            << static_cast<double>(counted::moves_) / n << " moves/pop"
+            << endl;
+}
+
+/// Compare pushing and popping \c n elements made by \c make using \c
+/// mu::adt::heap and the reference swap based implementations.
+template <typename T, typename Make>
+static void compare(const string& name, size_t n, Make make)
+{
+    mt19937_64 generator(n);
+    vector<T> es;
+    es.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        es.push_back(make(generator()));
+    }
+
+    auto ms = [](chrono::steady_clock::time_point start) {
+        return chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - start).count();
+    };
+
+    auto input = es;
+    heap<T> h;
+    auto start = chrono::steady_clock::now();
+    for (auto& e : input) {
+        h.emplace(move(e));
+    }
+    while (!h.empty()) {
+        T e = h.pop_top();
+    }
+    cout << name << " mu::adt::heap " << ms(start) << " ms" << endl;
+
+    input = es;
+    deque<T> a;
+    start = chrono::steady_clock::now();
+    for (auto& e : input) {
+        swap_push(a, move(e));
+    }
+    while (!a.empty()) {
+        T e = move(a[0]);
+        swap_pop(a);
+    }
+    cout << name << " reference swap " << ms(start) << " ms" << endl;
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " ELEMENTS";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    long long element_count = atoll(argv[1]);
+    if (element_count < 1) {
+        cerr << "ELEMENTS must be > 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    const auto n = static_cast<size_t>(element_count);
+
+    cout << "elements " << n << endl;
+    auto push = [](heap<counted>& h, counted&& e) { h.emplace(move(e)); };
+    drain<heap<counted>>("top() + pop()", n, push, [](heap<counted>& h) {
+        counted e = h.top();
+        h.pop();
+    });
+    drain<heap<counted>>("pop_top()", n, push, [](heap<counted>& h) {
+        counted e = h.pop_top();
+    });
+
+    // The reference implementation operates on the underlying sequence.
+    drain<deque<counted>>(
+            "reference swap pop",
+            n,
+            [](deque<counted>& a, counted&& e) {
+                mu::alg::heap::emplace(a, move(e));
+            },
+            [](deque<counted>& a) {
+                counted e = a[0];
+                swap_pop(a);
+            });
+
+    // Heavyweight elements.
+    compare<string>("std::string", n, [](size_t v) {
+        // Exceed the small string optimization's capacity.
+        return string(32, 'x') + to_string(v);
+    });
+    compare<shared_ptr<size_t>>("std::shared_ptr", n, [](size_t v) {
+        return make_shared<size_t>(v);
+    });
+
+    return 0;
+}
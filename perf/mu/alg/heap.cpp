@@ -0,0 +1,121 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mu/alg/heap.h>
+#include <mu/bench/counters.h>
+
+/// Benchmark heap construction and selection with the following runtime
+/// parameters
+///
+/// - total number of elements
+/// - threads used by the parallel algorithms
+/// - number of minimum elements to select
+///
+/// The sequential and parallel \c mu::alg::heap algorithms are timed against
+/// \c std::make_heap and \c std::partial_sort on copies of the same random
+/// input.  Hardware events counted by \c perf_event_open, including those of
+/// the parallel algorithms' threads, are reported per element where available.
+
+using namespace std;
+namespace heap = mu::alg::heap;
+
+typedef size_t element;
+
+static vector<element> random_elements(size_t n)
+{
+    mt19937_64 generator(n);
+    vector<element> es(n);
+    for (auto& e : es) {
+        e = generator();
+    }
+    return es;
+}
+
+/// Time \c f applied to a fresh copy of \c input and report the result.
+static void time(
+        const string& name,
+        const vector<element>& input,
+        const function<void (vector<element>&)>& f)
+{
+    auto es = input;
+    mu::bench::counters hw(true);
+    const auto start = chrono::steady_clock::now();
+    hw.start();
+    f(es);
+    const auto counts = hw.stop();
+    const auto stop = chrono::steady_clock::now();
+    cout << name << " "
+            << chrono::duration_cast<chrono::milliseconds>(stop - start).count()
+            << " ms";
+    for (const auto& count : counts) {
+        cout << ", " << static_cast<double>(count.second) / input.size()
+                << " " << count.first;
+    }
+    cout << endl;
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " ELEMENTS [THREADS] [N]";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    long long element_count = atoll(argv[1]);
+    long long thread_count =
+            argc > 2 ? atoll(argv[2]) : thread::hardware_concurrency();
+    long long n = argc > 3 ? atoll(argv[3]) : 1000;
+    if (element_count < 1 || thread_count < 1 || n < 1) {
+        cerr << "parameters must each be > 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    if (n > element_count) {
+        cerr << "N must be <= ELEMENTS" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+
+    cout << "elements " << element_count << ", threads " << thread_count
+            << ", n " << n << endl;
+    if (!mu::bench::counters().available())
+        cout << "hardware counters unavailable" << endl;
+    const auto input = random_elements(static_cast<size_t>(element_count));
+    const auto threads = static_cast<size_t>(thread_count);
+    const auto count = static_cast<size_t>(n);
+
+    // Construction.  std::make_heap builds a maximum heap, so invert the order.
+    time("std::make_heap", input, [](vector<element>& es) {
+        make_heap(es.begin(), es.end(), greater<element>());
+    });
+    time("mu::alg::heap::make", input, [](vector<element>& es) {
+        heap::make(es);
+    });
+    time("mu::alg::heap::parallel_make", input, [=](vector<element>& es) {
+        heap::parallel_make(es, threads);
+    });
+
+    // Selection.
+    time("std::partial_sort", input, [=](vector<element>& es) {
+        partial_sort(es.begin(), es.begin() + count, es.end());
+    });
+    time("mu::alg::heap::top_n", input, [=](vector<element>& es) {
+        heap::top_n(es, count, threads);
+    });
+
+    return 0;
+}
@@ -0,0 +1,541 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <thread>
+
+#include <mu/bench/bench.h>
+#include <mu/bench/counters.h>
+#include <mu/bench/fairness.h>
+#include <mu/lf/stats.h>
+
+using namespace std;
+
+namespace mu {
+namespace bench {
+
+vector<benchmark>& registry()
+{
+    static vector<benchmark> benchmarks;
+    return benchmarks;
+}
+
+namespace {
+
+/// Command line options.
+struct options {
+    string filter = ".*";
+    size_t repetitions = 5;
+    size_t warmup = 1;
+    size_t iterations = 0;      // Zero for each benchmark's default.
+    string json;                // Output file, "-" for standard output.
+    bool list = false;
+    bool counters = false;      // Report hardware performance counters.
+};
+
+/// Statistics over repetitions.
+struct summary {
+    double mean;
+    double median;
+    double stddev;
+    double min;
+    double max;
+};
+
+/// The percentiles reported for histograms.
+const vector<double> PERCENTILES = {50, 90, 99, 99.9, 99.99};
+
+/// A summarized histogram, e.g. of latencies in nanoseconds.
+struct distribution {
+    uint64_t count;
+    double mean;
+    uint64_t min;
+    vector<uint64_t> percentiles;   // Of PERCENTILES.
+    uint64_t max;
+};
+
+/// The fairness of threads' throughputs.
+struct fairness {
+    double jain_index;              // Averaged over repetitions.
+    double min_ops_per_sec;         // Of the slowest thread in any repetition.
+    double max_ops_per_sec;         // Of the fastest thread in any repetition.
+};
+
+/// The result of running one point of a benchmark's parameter space.
+struct result {
+    string name;
+    arguments args;
+    size_t thread_count;
+    size_t iterations;
+    size_t repetitions;
+    summary ns_per_op;
+    bench::fairness fairness;
+    map<string, double> counters;   // Per operation, averaged.
+    map<string, distribution> latencies;        // Over all threads and
+    map<string, distribution> distributions;    // repetitions.
+};
+
+/// Measurements accumulated over repetitions.
+struct accumulator {
+    map<string, double> counters;
+    histograms latencies;
+    histograms distributions;
+    vector<double> jain_indices;
+    vector<double> thread_ops_per_sec;
+};
+
+summary summarize(vector<double> v)
+{
+    sort(v.begin(), v.end());
+    const size_t n = v.size();
+    double sum = 0;
+    for (auto x : v) {
+        sum += x;
+    }
+    const double mean = sum / n;
+    double squares = 0;
+    for (auto x : v) {
+        squares += (x - mean) * (x - mean);
+    }
+    const double median =
+            n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+    const double stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+    return summary{mean, median, stddev, v.front(), v.back()};
+}
+
+map<string, distribution> summarize(const histograms& hs)
+{
+    map<string, distribution> ds;
+    for (const auto& h : hs) {
+        vector<uint64_t> percentiles;
+        for (auto p : PERCENTILES) {
+            percentiles.push_back(h.second->percentile(p));
+        }
+        ds[h.first] = distribution{h.second->count(), h.second->mean(),
+                h.second->min(), percentiles, h.second->max()};
+    }
+    return ds;
+}
+
+/// Merge each of \c from into the same named histogram of \c to.
+void merge(histograms& to, const histograms& from)
+{
+    for (const auto& h : from) {
+        auto& t = to[h.first];
+        if (!t)
+            t.reset(new histogram);
+        t->merge(*h.second);
+    }
+}
+
+string full_name(const benchmark& b, const arguments& args, size_t threads)
+{
+    ostringstream os;
+    os << b.name();
+    for (const auto& a : b.args()) {
+        os << "/" << a.first << ":" << args.at(a.first);
+    }
+    os << "/threads:" << threads;
+    return os.str();
+}
+
+/// Invoke f for each combination of the benchmark's argument values.
+void for_each_arguments(
+        const benchmark& b,
+        size_t i,
+        arguments& args,
+        const function<void (const arguments&)>& f)
+{
+    if (i == b.args().size()) {
+        f(args);
+        return;
+    }
+    for (auto v : b.args()[i].second) {
+        args[b.args()[i].first] = v;
+        for_each_arguments(b, i + 1, args, f);
+    }
+}
+
+/// Run one repetition, accumulating its measurements.
+///
+/// \param hardware Also count hardware events, per thread, while running.
+/// \return the elapsed time in nanoseconds.
+double run_once(
+        const benchmark& b,
+        const arguments& args,
+        size_t thread_count,
+        size_t iterations,
+        bool hardware,
+        accumulator& a)
+{
+    auto f = b.make()(args, thread_count);
+
+    vector<context> contexts;
+    contexts.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        contexts.emplace_back(args, iterations, thread_count, i);
+    }
+
+    // Release the threads together once all have started.
+    atomic<size_t> ready(0);
+    atomic<bool> go(false);
+    vector<double> thread_ns(thread_count);
+    vector<thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i] {
+            unique_ptr<bench::counters> hw(
+                    hardware ? new bench::counters : nullptr);
+            ++ready;
+            while (!go.load(memory_order_acquire)) {
+                this_thread::yield();
+            }
+            const uint64_t retries = lf::thread_stats().retries;
+            const auto start = chrono::steady_clock::now();
+            if (hw)
+                hw->start();
+            f->run(contexts[i]);
+            if (hw) {
+                for (const auto& c : hw->stop()) {
+                    contexts[i].count(c.first, c.second);
+                }
+            }
+            thread_ns[i] = chrono::duration<double, nano>(
+                    chrono::steady_clock::now() - start).count();
+#if defined(MU_LF_STATS)
+            contexts[i].count("retries", lf::thread_stats().retries - retries);
+#else
+            (void) retries;
+#endif
+        });
+    }
+    while (ready.load() < thread_count) {
+        this_thread::yield();
+    }
+
+    const auto start = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    for (auto& t : threads) {
+        t.join();
+    }
+    const auto stop = chrono::steady_clock::now();
+
+    for (const auto& c : contexts) {
+        for (const auto& counter : c.counters()) {
+            a.counters[counter.first] += counter.second;
+        }
+        merge(a.latencies, c.latencies());
+        merge(a.distributions, c.distributions());
+    }
+
+    vector<double> ops_per_sec;
+    for (auto ns : thread_ns) {
+        ops_per_sec.push_back(ns > 0 ? iterations * 1e9 / ns : 0);
+    }
+    a.jain_indices.push_back(jain_index(ops_per_sec));
+    a.thread_ops_per_sec.insert(
+            a.thread_ops_per_sec.end(), ops_per_sec.begin(), ops_per_sec.end());
+
+    return chrono::duration<double, nano>(stop - start).count();
+}
+
+result run_point(
+        const benchmark& b,
+        const arguments& args,
+        size_t thread_count,
+        const options& o)
+{
+    const size_t iterations = o.iterations ? o.iterations : b.iterations();
+    const double operations = static_cast<double>(iterations * thread_count);
+
+    for (size_t i = 0; i < o.warmup; ++i) {
+        accumulator ignored;
+        run_once(b, args, thread_count, iterations, o.counters, ignored);
+    }
+
+    vector<double> ns_per_op;
+    accumulator a;
+    for (size_t i = 0; i < o.repetitions; ++i) {
+        ns_per_op.push_back(run_once(
+                b, args, thread_count, iterations, o.counters, a) /
+                operations);
+    }
+    for (auto& c : a.counters) {
+        c.second /= operations * o.repetitions;
+    }
+
+    const auto ops = minmax_element(
+            a.thread_ops_per_sec.begin(), a.thread_ops_per_sec.end());
+    const bench::fairness fairness{
+            summarize(a.jain_indices).mean, *ops.first, *ops.second};
+
+    return result{
+            full_name(b, args, thread_count),
+            args,
+            thread_count,
+            iterations,
+            o.repetitions,
+            summarize(ns_per_op),
+            fairness,
+            a.counters,
+            summarize(a.latencies),
+            summarize(a.distributions)};
+}
+
+string percentile_name(double p)
+{
+    ostringstream os;
+    os << "p" << p;
+    return os.str();
+}
+
+/// Print a percentile table of the distributions, if any.
+void print(
+        ostream& os,
+        const string& title,
+        const map<string, distribution>& ds)
+{
+    if (ds.empty())
+        return;
+    os << "    " << left << setw(24) << title << right;
+    for (auto p : PERCENTILES) {
+        os << setw(10) << percentile_name(p);
+    }
+    os << setw(12) << "max" << setw(12) << "count" << endl;
+    for (const auto& d : ds) {
+        os << "    " << left << setw(24) << d.first << right;
+        for (auto v : d.second.percentiles) {
+            os << setw(10) << v;
+        }
+        os << setw(12) << d.second.max << setw(12) << d.second.count << endl;
+    }
+}
+
+void print(ostream& os, const result& r)
+{
+    const double cv = r.ns_per_op.mean > 0 ?
+            100 * r.ns_per_op.stddev / r.ns_per_op.mean : 0;
+    os << left << setw(64) << r.name << right << fixed << setprecision(1)
+            << setw(12) << r.ns_per_op.median << " ns/op"
+            << setw(8) << cv << "% cv"
+            << setw(14) << setprecision(0) << 1e9 / r.ns_per_op.median
+            << " ops/s";
+    os << setprecision(3);
+    if (r.thread_count > 1)
+        os << "  fairness=" << r.fairness.jain_index;
+    for (const auto& c : r.counters) {
+        os << "  " << c.first << "=" << c.second;
+    }
+    os << endl;
+
+    print(os, "latency (ns)", r.latencies);
+    print(os, "distribution", r.distributions);
+}
+
+string quote(const string& s)
+{
+    string q = "\"";
+    for (auto c : s) {
+        if (c == '"' || c == '\\')
+            q += '\\';
+        q += c;
+    }
+    return q + "\"";
+}
+
+void write_json(ostream& os, const map<string, distribution>& ds)
+{
+    os << "{";
+    size_t i = 0;
+    for (const auto& d : ds) {
+        os << (i++ ? "," : "") << "\n        " << quote(d.first) << ": {"
+                << "\"count\": " << d.second.count
+                << ", \"mean\": " << d.second.mean
+                << ", \"min\": " << d.second.min;
+        for (size_t k = 0; k < PERCENTILES.size(); ++k) {
+            os << ", " << quote(percentile_name(PERCENTILES[k])) << ": "
+                    << d.second.percentiles[k];
+        }
+        os << ", \"max\": " << d.second.max << "}";
+    }
+    os << (i ? "\n      " : "") << "}";
+}
+
+void write_json(ostream& os, const options& o, const vector<result>& results)
+{
+    const time_t now = time(nullptr);
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    os << "{\n"
+            << "  \"context\": {\n"
+            << "    \"date\": " << quote(date) << ",\n"
+            << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n"
+            << "    \"repetitions\": " << o.repetitions << ",\n"
+            << "    \"warmup\": " << o.warmup << "\n"
+            << "  },\n"
+            << "  \"benchmarks\": [";
+    os << setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << (i ? "," : "") << "\n    {\n"
+                << "      \"name\": " << quote(r.name) << ",\n"
+                << "      \"args\": {";
+        size_t j = 0;
+        for (const auto& a : r.args) {
+            os << (j++ ? ", " : "") << quote(a.first) << ": " << a.second;
+        }
+        os << "},\n"
+                << "      \"threads\": " << r.thread_count << ",\n"
+                << "      \"iterations\": " << r.iterations << ",\n"
+                << "      \"repetitions\": " << r.repetitions << ",\n"
+                << "      \"ns_per_op\": {"
+                << "\"mean\": " << r.ns_per_op.mean
+                << ", \"median\": " << r.ns_per_op.median
+                << ", \"stddev\": " << r.ns_per_op.stddev
+                << ", \"min\": " << r.ns_per_op.min
+                << ", \"max\": " << r.ns_per_op.max << "},\n"
+                << "      \"ops_per_sec\": " << 1e9 / r.ns_per_op.median << ",\n"
+                << "      \"counters\": {";
+        j = 0;
+        for (const auto& c : r.counters) {
+            os << (j++ ? ", " : "") << quote(c.first) << ": " << c.second;
+        }
+        os << "},\n"
+                << "      \"fairness\": {"
+                << "\"jain_index\": " << r.fairness.jain_index
+                << ", \"min_thread_ops_per_sec\": "
+                << r.fairness.min_ops_per_sec
+                << ", \"max_thread_ops_per_sec\": "
+                << r.fairness.max_ops_per_sec << "},\n"
+                << "      \"latency_ns\": ";
+        write_json(os, r.latencies);
+        os << ",\n      \"distributions\": ";
+        write_json(os, r.distributions);
+        os << "\n    }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+string usage(const char* program)
+{
+    return string("usage: ") + program + " [--filter=REGEX] "
+            "[--repetitions=N] [--warmup=N] [--iterations=N] [--json=FILE|-] "
+            "[--counters] [--list]";
+}
+
+/// Parse a positive integer option value, or exit.
+size_t parse_count(const char* program, const string& option, const string& v)
+{
+    char* end = nullptr;
+    const long long n = strtoll(v.c_str(), &end, 10);
+    if (v.empty() || *end != '\0' || n < 0) {
+        cerr << option << " must be a non-negative integer" << endl;
+        cerr << usage(program) << endl;
+        exit(1);
+    }
+    return static_cast<size_t>(n);
+}
+
+options parse(int argc, char** argv)
+{
+    options o;
+    for (int i = 1; i < argc; ++i) {
+        const string a = argv[i];
+        const auto eq = a.find('=');
+        const string option = a.substr(0, eq);
+        const string value = eq == string::npos ? "" : a.substr(eq + 1);
+        if (option == "--filter") {
+            o.filter = value;
+        } else if (option == "--repetitions") {
+            o.repetitions = parse_count(argv[0], option, value);
+        } else if (option == "--warmup") {
+            o.warmup = parse_count(argv[0], option, value);
+        } else if (option == "--iterations") {
+            o.iterations = parse_count(argv[0], option, value);
+        } else if (option == "--json") {
+            o.json = value;
+        } else if (option == "--counters") {
+            o.counters = true;
+        } else if (option == "--list") {
+            o.list = true;
+        } else {
+            cerr << usage(argv[0]) << endl;
+            exit(1);
+        }
+    }
+    if (o.repetitions < 1) {
+        cerr << "--repetitions must be > 0" << endl;
+        exit(1);
+    }
+    return o;
+}
+
+} // namespace
+
+int run(int argc, char** argv)
+{
+    const options o = parse(argc, argv);
+    const regex filter(o.filter);
+
+    // Results are written to standard error when JSON goes to standard output.
+    ostream& console = o.json == "-" ? cerr : cout;
+
+    if (o.counters && !o.list) {
+        const bench::counters hw;
+        if (!hw.unavailable().empty()) {
+            console << "hardware counters unavailable:";
+            for (const auto& name : hw.unavailable()) {
+                console << " " << name;
+            }
+            console << endl;
+        }
+    }
+
+    vector<result> results;
+    for (const auto& b : registry()) {
+        arguments args;
+        for_each_arguments(b, 0, args, [&](const arguments& args) {
+            for (auto t : b.thread_counts()) {
+                const string name = full_name(b, args, t);
+                if (!regex_search(name, filter))
+                    continue;
+                if (o.list) {
+                    console << name << endl;
+                    continue;
+                }
+                results.push_back(run_point(b, args, t, o));
+                print(console, results.back());
+            }
+        });
+    }
+
+    if (o.json == "-") {
+        write_json(cout, o, results);
+    } else if (!o.json.empty()) {
+        ofstream f(o.json);
+        write_json(f, o, results);
+        if (!f) {
+            cerr << "failed to write " << o.json << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace bench
+} // namespace mu
+
+int main(int argc, char** argv)
+{
+    return mu::bench::run(argc, argv);
+}
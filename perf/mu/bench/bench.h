@@ -0,0 +1,220 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mu/histogram.h>
+
+namespace mu {
+
+/// A self-contained micro-benchmark harness.
+///
+/// Benchmarks are registered with a parameter space of named integer
+/// arguments and thread counts.  Each point in the space is run for a number of
+/// untimed warmup repetitions followed by timed repetitions, and statistics
+/// over the repetitions are reported on the console and optionally as JSON.
+///
+/// A repetition constructs the benchmark's fixture, untimed, then starts one
+/// thread per requested thread, releases them together and times until the
+/// last finishes.  Each thread invokes the fixture's \c run with its own \c
+/// context and is expected to perform \c context::iterations() operations.
+///
+/// Fixtures may also record latencies and other distributions, e.g. of retries,
+/// into named histograms, which are merged over threads and repetitions and
+/// reported as percentiles.  Jain's fairness index of the threads' throughputs
+/// is reported, as are, with \c MU_LF_STATS, the lock-free containers' retries
+/// per operation.  Optionally, hardware performance counters are read around
+/// each thread's \c run and reported per operation alongside the fixture's own
+/// counters.
+namespace bench {
+
+/// Benchmark argument values by name.
+using arguments = std::map<std::string, int64_t>;
+
+/// Histograms by name.
+using histograms = std::map<std::string, std::unique_ptr<histogram>>;
+
+/// \return a monotonic timestamp in nanoseconds, for latency measurement.
+inline uint64_t now()
+{
+    return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/// The context of one benchmark thread within a repetition.
+class context {
+public:
+    context(
+            const arguments& args,
+            size_t iterations,
+            size_t thread_count,
+            size_t thread_index) :
+            args_(args),
+            iterations_(iterations),
+            thread_count_(thread_count),
+            thread_index_(thread_index)
+    {
+    }
+
+    /// \return the value of the named argument.
+    /// \exception \c std::out_of_range if the argument wasn't registered.
+    int64_t arg(const std::string& name) const { return args_.at(name); }
+
+    /// \return the number of operations the thread should perform.
+    size_t iterations() const { return iterations_; }
+
+    size_t thread_count() const { return thread_count_; }
+    size_t thread_index() const { return thread_index_; }
+
+    /// Add to a named counter.  Counters are summed over threads, averaged
+    /// over repetitions and reported per operation.
+    void count(const std::string& name, double value) { counters_[name] += value; }
+
+    const std::map<std::string, double>& counters() const { return counters_; }
+
+    /// \return the thread's histogram of the named latency, in nanoseconds.
+    ///         Look it up before, rather than during, timed operations.
+    histogram& latency(const std::string& name) { return get(latencies_, name); }
+
+    /// \return the thread's histogram of the named distribution, as \c
+    ///         latency but of other values, e.g. retries per operation.
+    histogram& distribution(const std::string& name)
+    {
+        return get(distributions_, name);
+    }
+
+    const histograms& latencies() const { return latencies_; }
+    const histograms& distributions() const { return distributions_; }
+
+private:
+    static histogram& get(histograms& hs, const std::string& name)
+    {
+        auto& h = hs[name];
+        if (!h)
+            h.reset(new histogram);
+        return *h;
+    }
+
+    const arguments& args_;
+    const size_t iterations_;
+    const size_t thread_count_;
+    const size_t thread_index_;
+    std::map<std::string, double> counters_;
+    histograms latencies_;
+    histograms distributions_;
+};
+
+/// State shared by the threads of one repetition.  Constructed and destroyed
+/// outside of the timed region.
+class fixture {
+public:
+    virtual ~fixture() = default;
+
+    /// Perform \c c.iterations() operations.  Invoked concurrently.
+    virtual void run(context& c) = 0;
+};
+
+/// A registered benchmark and its parameter space.
+class benchmark {
+public:
+    using factory = std::function<
+            std::unique_ptr<fixture> (const arguments&, size_t thread_count)>;
+
+    constexpr static const size_t DEFAULT_ITERATIONS = 100000;
+
+    benchmark(const std::string& name, const factory& f) :
+            name_(name),
+            factory_(f),
+            thread_counts_({1}),
+            iterations_(DEFAULT_ITERATIONS)
+    {
+    }
+
+    /// Run with each of the argument's values, in combination with those of
+    /// any other arguments.
+    benchmark& arg(const std::string& name, const std::vector<int64_t>& values)
+    {
+        args_.emplace_back(name, values);
+        return *this;
+    }
+
+    /// Run with each of the thread counts.
+    benchmark& threads(const std::vector<size_t>& counts)
+    {
+        thread_counts_ = counts;
+        return *this;
+    }
+
+    /// Set the default number of operations per thread.
+    benchmark& iterations(size_t n)
+    {
+        iterations_ = n;
+        return *this;
+    }
+
+    const std::string& name() const { return name_; }
+    const factory& make() const { return factory_; }
+    const std::vector<std::pair<std::string, std::vector<int64_t>>>& args() const
+    {
+        return args_;
+    }
+    const std::vector<size_t>& thread_counts() const { return thread_counts_; }
+    size_t iterations() const { return iterations_; }
+
+private:
+    std::string name_;
+    factory factory_;
+    std::vector<std::pair<std::string, std::vector<int64_t>>> args_;
+    std::vector<size_t> thread_counts_;
+    size_t iterations_;
+};
+
+/// \return all registered benchmarks.
+std::vector<benchmark>& registry();
+
+/// Register a benchmark constructing fixtures with \c f.
+/// \return the benchmark, for parameter space configuration.
+inline benchmark& add(const std::string& name, const benchmark::factory& f)
+{
+    registry().emplace_back(name, f);
+    return registry().back();
+}
+
+/// Register a benchmark.
+///
+/// \tparam F The fixture type, derived from \c fixture and constructable from
+///         <tt>(const arguments&, size_t thread_count)</tt>.
+/// \return the benchmark, for parameter space configuration.
+template <typename F>
+benchmark& add(const std::string& name)
+{
+    return add(name, [](const arguments& args, size_t thread_count) {
+        return std::unique_ptr<fixture>(new F(args, thread_count));
+    });
+}
+
+/// Register benchmarks at static initialization, e.g.
+/// \code static mu::bench::registrar _([] { add<f>("f").arg(...); }); \endcode
+struct registrar {
+    explicit registrar(const std::function<void ()>& f) { f(); }
+};
+
+/// Parse the command line and run the matching registered benchmarks.
+///
+/// \return a process exit status.
+int run(int argc, char** argv);
+
+} // namespace bench
+} // namespace mu
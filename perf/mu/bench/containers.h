@@ -0,0 +1,171 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <mu/bench/bench.h>
+#include <mu/histogram.h>
+#include <mu/lf/stats.h>
+
+namespace mu {
+namespace bench {
+
+/// Fixtures of a \c Container with the \c mu::lf::queue push and pop
+/// interface, a \c value_type constructable from a \c size_t ID and a
+/// constructor taking the \c "capacity" argument, shared by the queue and
+/// stack benchmarks.
+
+/// Each thread alternately pushes and pops elements of \c Container.
+template <typename Container>
+class push_pop_in : public fixture {
+public:
+    push_pop_in(const arguments& args, size_t) : c_(args.at("capacity")) {}
+
+    void run(context& c) override
+    {
+        using P = typename Container::value_type;
+        const P p(c.thread_index());
+        P out;
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            c_.push(p);
+            // Succeeds eventually as this thread's element is yet to be popped.
+            while (!c_.pop(out)) {
+            }
+        }
+    }
+
+private:
+    Container c_;
+};
+
+/// Even threads produce and odd threads consume elements of \c Container.
+template <typename Container>
+class produce_consume_in : public fixture {
+public:
+    produce_consume_in(const arguments& args, size_t) :
+            c_(args.at("capacity"))
+    {
+    }
+
+    void run(context& c) override
+    {
+        using P = typename Container::value_type;
+        if (c.thread_index() % 2 == 0) {
+            for (size_t i = 0; i < c.iterations(); ++i) {
+                c_.push(P(i));
+            }
+        } else {
+            P out;
+            size_t failures = 0;
+            for (size_t i = 0; i < c.iterations(); ) {
+                if (c_.pop(out))
+                    ++i;
+                else
+                    ++failures;
+            }
+            c.count("empty_pops", failures);
+        }
+    }
+
+private:
+    Container c_;
+};
+
+/// As \c push_pop_in, recording the latency of each push and of each pop,
+/// including any retries of the latter.
+template <typename Container>
+class push_pop_latency_in : public fixture {
+public:
+    push_pop_latency_in(const arguments& args, size_t) :
+            c_(args.at("capacity"))
+    {
+    }
+
+    void run(context& c) override
+    {
+        using P = typename Container::value_type;
+        const P p(c.thread_index());
+        P out;
+        histogram& push_latency = c.latency("push");
+        histogram& pop_latency = c.latency("pop");
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            const uint64_t start = now();
+            c_.push(p);
+            const uint64_t pushed = now();
+            while (!c_.pop(out)) {
+            }
+            pop_latency.record(now() - pushed);
+            push_latency.record(pushed - start);
+        }
+    }
+
+private:
+    Container c_;
+};
+
+/// As \c produce_consume_in, recording the latency from before each push to
+/// after the pop of the pushed element, carried as the element's ID.
+template <typename Container>
+class handoff_in : public fixture {
+public:
+    handoff_in(const arguments& args, size_t) : c_(args.at("capacity")) {}
+
+    void run(context& c) override
+    {
+        using P = typename Container::value_type;
+        if (c.thread_index() % 2 == 0) {
+            for (size_t i = 0; i < c.iterations(); ++i) {
+                c_.push(P(now()));
+            }
+        } else {
+            P out;
+            histogram& latency = c.latency("handoff");
+            for (size_t i = 0; i < c.iterations(); ) {
+                if (c_.pop(out)) {
+                    latency.record(now() - out.id());
+                    ++i;
+                }
+            }
+        }
+    }
+
+private:
+    Container c_;
+};
+
+/// Each thread alternately pushes and pops, recording the latency of each
+/// push and pop pair and the retries it took in the container, with \c
+/// MU_LF_STATS, to expose threads starved by losing compare and set races.
+template <typename Container>
+class contended_in : public fixture {
+public:
+    contended_in(const arguments& args, size_t) : c_(args.at("capacity")) {}
+
+    void run(context& c) override
+    {
+        using P = typename Container::value_type;
+        const P p(c.thread_index());
+        P out;
+        histogram& latency = c.latency("push_pop");
+        histogram& retries = c.distribution("retries");
+        uint64_t& retried = mu::lf::thread_stats().retries;
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            const uint64_t start = now();
+            const uint64_t before = retried;
+            c_.push(p);
+            while (!c_.pop(out)) {
+            }
+            retries.record(retried - before);
+            latency.record(now() - start);
+        }
+    }
+
+private:
+    Container c_;
+};
+
+} // namespace bench
+} // namespace mu
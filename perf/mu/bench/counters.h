@@ -0,0 +1,169 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mu {
+namespace bench {
+
+/// Hardware performance counters read with \c perf_event_open, counting user
+/// space events of the calling thread, and optionally of threads it creates
+/// while counting.
+///
+/// Each event is opened independently so those the kernel, hardware or
+/// virtualization doesn't permit are omitted rather than failing the rest.
+/// Counts are scaled for any time the event wasn't scheduled on the PMU.
+/// Without \c perf_event_open no events are available, so callers report
+/// nothing rather than failing.
+class counters {
+public:
+    /// Counts by event name.
+    using counts = std::vector<std::pair<std::string, uint64_t>>;
+
+    /// \param inherit Also count threads created after construction, which
+    ///        are included once they have exited.
+    explicit counters(bool inherit = false);
+    counters(const counters&) = delete;
+    counters& operator=(const counters&) = delete;
+    ~counters();
+
+    /// \return \c true iff any event could be opened.
+    bool available() const { return !events_.empty(); }
+
+    /// \return the names of the events that couldn't be opened.
+    const std::vector<std::string>& unavailable() const { return unavailable_; }
+
+    /// Reset and start counting.
+    void start();
+
+    /// Stop counting.
+    ///
+    /// \return the counts of the available events since \c start().
+    counts stop();
+
+private:
+    struct event {
+        std::string name_;
+        int fd_;
+    };
+
+    /// Open an event, recording it as available or not.
+    void open(const char* name, uint32_t type, uint64_t config, bool inherit);
+
+    std::vector<event> events_;
+    std::vector<std::string> unavailable_;
+};
+
+inline counters::counters(const bool inherit)
+{
+#if defined(__linux__)
+    const auto cache = [](uint64_t cache, uint64_t op, uint64_t result) {
+        return cache | (op << 8) | (result << 16);
+    };
+    open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, inherit);
+    open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+            inherit);
+    open("cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+            inherit);
+    open("llc_misses", PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL,
+            PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+            inherit);
+    open("dtlb_misses", PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB,
+            PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+            inherit);
+    open("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+            inherit);
+#else
+    unavailable_ = {"cycles", "instructions", "cache_misses", "llc_misses",
+            "dtlb_misses", "branch_misses"};
+    (void) inherit;
+#endif
+}
+
+inline counters::~counters()
+{
+#if defined(__linux__)
+    for (const auto& e : events_) {
+        close(e.fd_);
+    }
+#endif
+}
+
+inline void counters::open(
+        const char* const name,
+        const uint32_t type,
+        const uint64_t config,
+        const bool inherit)
+{
+#if defined(__linux__)
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+    const int fd = static_cast<int>(
+            syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd >= 0)
+        events_.push_back(event{name, fd});
+    else
+        unavailable_.push_back(name);
+#else
+    (void) type;
+    (void) config;
+    (void) inherit;
+    unavailable_.push_back(name);
+#endif
+}
+
+inline void counters::start()
+{
+#if defined(__linux__)
+    for (const auto& e : events_) {
+        ioctl(e.fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(e.fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+inline counters::counts counters::stop()
+{
+    counts cs;
+#if defined(__linux__)
+    for (const auto& e : events_) {
+        ioctl(e.fd_, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (const auto& e : events_) {
+        // The count, then the times enabled and running.
+        uint64_t values[3] = {};
+        if (read(e.fd_, values, sizeof(values)) != sizeof(values))
+            continue;
+        uint64_t count = values[0];
+        if (values[2] > 0 && values[2] < values[1]) {
+            count = static_cast<uint64_t>(
+                    static_cast<double>(count) * values[1] / values[2]);
+        }
+        cs.emplace_back(e.name_, count);
+    }
+#endif
+    return cs;
+}
+
+} // namespace bench
+} // namespace mu
@@ -0,0 +1,26 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <vector>
+
+namespace mu {
+namespace bench {
+
+/// \return Jain's fairness index of the allocations \c xs, e.g. per thread
+///         throughputs: 1 if all are equal, falling towards \c 1/n as one
+///         dominates.  1 if there are none.
+inline double jain_index(const std::vector<double>& xs)
+{
+    double sum = 0;
+    double squares = 0;
+    for (auto x : xs) {
+        sum += x;
+        squares += x * x;
+    }
+    return squares > 0 ? sum * sum / (xs.size() * squares) : 1;
+}
+
+} // namespace bench
+} // namespace mu
@@ -0,0 +1,65 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <random>
+
+#include <mu/adt/heap.h>
+#include <mu/bench/bench.h>
+
+/// \c mu::adt::heap benchmarks.
+
+using namespace mu::bench;
+using mu::adt::heap;
+
+namespace {
+
+/// Push and pop a random element on a heap of constant size.  Single threaded.
+class push_pop : public fixture {
+public:
+    push_pop(const arguments& args, size_t) : generator_(args.at("size"))
+    {
+        for (int64_t i = 0; i < args.at("size"); ++i) {
+            h_.push(generator_());
+        }
+    }
+
+    void run(context& c) override
+    {
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            h_.push(generator_());
+            h_.pop();
+        }
+    }
+
+protected:
+    std::mt19937_64 generator_;
+    heap<uint64_t> h_;
+};
+
+/// As \c push_pop, but taking the minimum with \c pop_top.
+class push_pop_top : public push_pop {
+public:
+    push_pop_top(const arguments& args, size_t n) :
+            push_pop(args, n),
+            sink_(0)
+    {
+    }
+
+    void run(context& c) override
+    {
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            h_.push(generator_());
+            sink_ += h_.pop_top();
+        }
+    }
+
+private:
+    uint64_t sink_;     // Consumes popped values.
+};
+
+registrar _([] {
+    add<push_pop>("adt::heap/push_pop").arg("size", {1024, 1 << 20});
+    add<push_pop_top>("adt::heap/push_pop_top").arg("size", {1024, 1 << 20});
+});
+
+} // namespace
@@ -0,0 +1,74 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+
+namespace mu {
+namespace bench {
+
+/// A mutex guarded \c std::list queue with the \c mu::lf::queue push and pop
+/// interface, for comparison.  The initial capacity is ignored.
+template <typename T>
+class locking_queue {
+public:
+    using value_type = T;
+
+    explicit locking_queue(size_t) {}
+
+    void push(const T& e)
+    {
+        std::lock_guard<std::mutex> _(mutex_);
+        list_.push_back(e);
+    }
+
+    bool pop(T& out)
+    {
+        std::lock_guard<std::mutex> _(mutex_);
+        if (list_.empty())
+            return false;
+        out = list_.front();
+        list_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::list<T> list_;
+};
+
+/// A mutex guarded \c std::list stack with the \c mu::lf::stack push and pop
+/// interface, for comparison.  The initial capacity is ignored.
+template <typename T>
+class locking_stack {
+public:
+    using value_type = T;
+
+    explicit locking_stack(size_t) {}
+
+    void push(const T& e)
+    {
+        std::lock_guard<std::mutex> _(mutex_);
+        list_.push_front(e);
+    }
+
+    bool pop(T& out)
+    {
+        std::lock_guard<std::mutex> _(mutex_);
+        if (list_.empty())
+            return false;
+        out = list_.front();
+        list_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::list<T> list_;
+};
+
+} // namespace bench
+} // namespace mu
@@ -0,0 +1,133 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <thread>
+#include <vector>
+
+#include <mu/bench/bench.h>
+#include <mu/bench/locking.h>
+#include <mu/bench/payload.h>
+#include <mu/lf/queue.h>
+#include <mu/lf/stack.h>
+#include <mu/lf/two_lock_queue.h>
+#include <mu/lf/wait_free_queue.h>
+
+/// Benchmarks of containers with more threads than CPUs, so threads are
+/// descheduled mid-operation.  Lock-free containers are compared against
+/// mutex guarded and spinlocked ones, which stall all threads while a lock
+/// holder is descheduled.
+///
+/// Even threads produce and odd threads consume, recording push latency and
+/// push to pop latency.  Each runs with 2, 4 and 8 threads per CPU.  The
+/// "nice" argument is the niceness of every other producer and consumer pair,
+/// mixing scheduling priorities under \c SCHED_OTHER.
+
+using namespace mu::bench;
+using mu::histogram;
+
+namespace {
+
+/// Set the calling thread's niceness, where supported.
+void nice(int niceness)
+{
+#if defined(__linux__)
+    if (niceness != 0) {
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                niceness);
+    }
+#else
+    (void) niceness;
+#endif
+}
+
+template <typename Container>
+class oversubscribed : public fixture {
+public:
+    oversubscribed(const arguments& args, size_t) :
+            c_(args.at("capacity")),
+            niceness_(static_cast<int>(args.at("nice")))
+    {
+    }
+
+    void run(context& c) override
+    {
+        using element = typename Container::value_type;
+
+        // Pair threads 0 and 1, 4 and 5, ... at default priority and threads
+        // 2 and 3, 6 and 7, ... niced.
+        if (c.thread_index() % 4 >= 2)
+            nice(niceness_);
+
+        if (c.thread_index() % 2 == 0) {
+            histogram& latency = c.latency("push");
+            for (size_t i = 0; i < c.iterations(); ++i) {
+                const uint64_t start = now();
+                c_.push(element(start));
+                latency.record(now() - start);
+            }
+        } else {
+            element out;
+            histogram& latency = c.latency("handoff");
+            size_t failures = 0;
+            for (size_t i = 0; i < c.iterations(); ) {
+                if (c_.pop(out)) {
+                    latency.record(now() - out.id());
+                    ++i;
+                } else {
+                    // Give way to producers sharing the CPU.
+                    ++failures;
+                    std::this_thread::yield();
+                }
+            }
+            c.count("empty_pops", failures);
+        }
+    }
+
+private:
+    Container c_;
+    const int niceness_;
+};
+
+template <typename T> using lf_queue = mu::lf::queue<T>;
+template <typename T> using lf_stack = mu::lf::stack<T>;
+template <typename T> using two_lock_queue = mu::lf::two_lock_queue<T>;
+template <typename T>
+using two_lock_queue_mcs = mu::lf::two_lock_queue<T, mu::mcs_spinlock>;
+template <typename T> using wait_free_queue = mu::lf::wait_free_queue<T>;
+
+/// Register a benchmark of \c Container of 64 byte payloads.
+template <template <typename> class Container>
+void add_oversubscribed(const std::string& name)
+{
+    using fixture = oversubscribed<Container<payload<64>>>;
+
+    const size_t cpu_count =
+            std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts;
+    for (size_t ratio : {2, 4, 8}) {
+        thread_counts.push_back(ratio * cpu_count);
+    }
+    add<fixture>("oversubscribed/" + name)
+            .arg("capacity", {1024})
+            .arg("nice", {0, 10, 19})
+            .threads(thread_counts)
+            .iterations(20000);
+}
+
+registrar _([] {
+    add_oversubscribed<lf_queue>("lf::queue");
+    add_oversubscribed<locking_queue>("locking_queue");
+    add_oversubscribed<two_lock_queue>("lf::two_lock_queue");
+    add_oversubscribed<two_lock_queue_mcs>("lf::two_lock_queue<mcs>");
+    add_oversubscribed<wait_free_queue>("lf::wait_free_queue");
+    add_oversubscribed<lf_stack>("lf::stack");
+    add_oversubscribed<locking_stack>("locking_stack");
+});
+
+} // namespace
@@ -0,0 +1,76 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <mu/bench/bench.h>
+
+namespace mu {
+namespace bench {
+
+/// A container element of \c N bytes, at least \c sizeof(size_t), carrying an
+/// ID in its first bytes.
+template <size_t N>
+struct payload {
+    static_assert(N >= sizeof(size_t), "payload too small for its ID");
+
+    payload() : payload(0) {}
+    payload(size_t id)
+    {
+        std::memset(bytes_, 0, N);
+        std::memcpy(bytes_, &id, sizeof(id));
+    }
+
+    size_t id() const
+    {
+        size_t id;
+        std::memcpy(&id, bytes_, sizeof(id));
+        return id;
+    }
+
+    char bytes_[N];
+};
+
+/// As \c payload, but not trivially copyable, to measure the containers'
+/// general rather than trivially copyable paths.
+template <size_t N>
+struct nontrivial_payload : payload<N> {
+    nontrivial_payload() = default;
+    nontrivial_payload(size_t id) : payload<N>(id) {}
+    nontrivial_payload(const nontrivial_payload& o) : payload<N>(o) {}
+    nontrivial_payload& operator=(const nontrivial_payload& o)
+    {
+        payload<N>::operator=(o);
+        return *this;
+    }
+};
+
+/// The payload sizes supported by \c by_payload.
+static const std::vector<int64_t> payload_sizes = {8, 64, 256};
+
+/// A fixture factory instantiating \c F with the size given by the \c
+/// "payload" argument, one of \c payload_sizes.
+template <template <size_t> class F>
+std::unique_ptr<fixture> by_payload(const arguments& args, size_t thread_count)
+{
+    switch (args.at("payload")) {
+    case 8:
+        return std::unique_ptr<fixture>(new F<8>(args, thread_count));
+    case 64:
+        return std::unique_ptr<fixture>(new F<64>(args, thread_count));
+    case 256:
+        return std::unique_ptr<fixture>(new F<256>(args, thread_count));
+    }
+    throw std::invalid_argument(
+            "unsupported payload " + std::to_string(args.at("payload")));
+}
+
+} // namespace bench
+} // namespace mu
@@ -0,0 +1,202 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <mu/bench/bench.h>
+#include <mu/bench/containers.h>
+#include <mu/bench/payload.h>
+#include <mu/lf/baskets_queue.h>
+#include <mu/lf/queue.h>
+#include <mu/lf/sharded_queue.h>
+#include <mu/lf/two_lock_queue.h>
+#include <mu/lf/wait_free_queue.h>
+
+/// Benchmarks of the \c mu::lf queues.
+
+using namespace mu::bench;
+
+namespace {
+
+/// As \c push_pop_in, with elements of type \c P in a queue storing nodes as
+/// \c Links specifies.
+template <typename P, typename Links = mu::lf::pointer_links>
+using push_pop_of = push_pop_in<mu::lf::queue<P, std::allocator<P>, Links>>;
+
+template <size_t N>
+using push_pop = push_pop_of<payload<N>>;
+
+/// As \c push_pop, with elements that aren't trivially copyable.
+template <size_t N>
+using push_pop_nontrivial = push_pop_of<nontrivial_payload<N>>;
+
+/// As \c push_pop, with nodes linked by 32-bit slab indices.
+template <size_t N>
+using push_pop_indexed = push_pop_of<payload<N>, mu::lf::index_links>;
+
+/// As \c push_pop, in the two-lock queue with ticket locks.
+template <size_t N>
+using push_pop_two_lock = push_pop_in<mu::lf::two_lock_queue<payload<N>>>;
+
+/// As \c push_pop, in the two-lock queue with MCS locks.
+template <size_t N>
+using push_pop_two_lock_mcs =
+        push_pop_in<mu::lf::two_lock_queue<payload<N>, mu::mcs_spinlock>>;
+
+/// As \c push_pop, in the baskets queue.
+template <size_t N>
+using push_pop_baskets = push_pop_in<mu::lf::baskets_queue<payload<N>>>;
+
+/// As \c push_pop, in the wait-free queue.
+template <size_t N>
+using push_pop_wait_free = push_pop_in<mu::lf::wait_free_queue<payload<N>>>;
+
+/// As \c push_pop, in the sharded queue, where threads on separate CPUs push
+/// and pop separate shards.
+template <size_t N>
+using push_pop_sharded = push_pop_in<mu::lf::sharded_queue<payload<N>>>;
+
+template <size_t N>
+using produce_consume = produce_consume_in<mu::lf::queue<payload<N>>>;
+
+/// As \c produce_consume, in the sharded queue, whose consumers steal from
+/// the producers' shards.
+template <size_t N>
+using produce_consume_sharded =
+        produce_consume_in<mu::lf::sharded_queue<payload<N>>>;
+
+/// As \c push_pop, recording the latency of each push and of each pop,
+/// including any retries of the latter.
+template <size_t N>
+using push_pop_latency = push_pop_latency_in<mu::lf::queue<payload<N>>>;
+
+/// As \c push_pop_latency, in the wait-free queue.
+template <size_t N>
+using push_pop_latency_wait_free =
+        push_pop_latency_in<mu::lf::wait_free_queue<payload<N>>>;
+
+/// As \c produce_consume, recording the latency from before each push to
+/// after the pop of the pushed element, carried as the element's ID.
+template <size_t N>
+using handoff = handoff_in<mu::lf::queue<payload<N>>>;
+
+/// As \c handoff, in the wait-free queue.
+template <size_t N>
+using handoff_wait_free = handoff_in<mu::lf::wait_free_queue<payload<N>>>;
+
+/// Each thread alternately pushes and pops, recording the latency of each
+/// push and pop pair and the retries it took.
+template <size_t N>
+using contended = contended_in<mu::lf::queue<payload<N>>>;
+
+/// As \c contended, in the baskets queue, whose failed enqueues join a
+/// basket rather than retrying from the tail.
+template <size_t N>
+using contended_baskets = contended_in<mu::lf::baskets_queue<payload<N>>>;
+
+/// As \c contended, in the wait-free queue, whose operations complete in
+/// bounded steps, to compare the tail latency with \c mu::lf::queue's.
+template <size_t N>
+using contended_wait_free =
+        contended_in<mu::lf::wait_free_queue<payload<N>>>;
+
+/// \return thread counts in powers of two from 2 up to 64, or the first at
+///         least the number of CPUs, over which to report throughput scaling
+///         without oversubscribing CPUs.
+std::vector<size_t> scaling_thread_counts()
+{
+    const size_t cpu_count =
+            std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts;
+    for (size_t n = 2; n <= 64; n *= 2) {
+        thread_counts.push_back(n);
+        if (n >= cpu_count)
+            break;
+    }
+    return thread_counts;
+}
+
+registrar _([] {
+    add("lf::queue/push_pop", by_payload<push_pop>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::queue/push_pop_nontrivial", by_payload<push_pop_nontrivial>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::queue/push_pop_indexed", by_payload<push_pop_indexed>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::two_lock_queue/push_pop", by_payload<push_pop_two_lock>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::two_lock_queue/push_pop_mcs", by_payload<push_pop_two_lock_mcs>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::baskets_queue/push_pop", by_payload<push_pop_baskets>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::wait_free_queue/push_pop", by_payload<push_pop_wait_free>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::sharded_queue/push_pop", by_payload<push_pop_sharded>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::queue/produce_consume", by_payload<produce_consume>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({2, 4, 8});
+    add("lf::sharded_queue/produce_consume",
+                by_payload<produce_consume_sharded>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({2, 4, 8});
+    add("lf::queue/scaling", by_payload<produce_consume>)
+            .arg("payload", {64})
+            .arg("capacity", {65536})
+            .threads(scaling_thread_counts());
+    add("lf::sharded_queue/scaling", by_payload<produce_consume_sharded>)
+            .arg("payload", {64})
+            .arg("capacity", {65536})
+            .threads(scaling_thread_counts());
+    add("lf::queue/push_pop_latency", by_payload<push_pop_latency>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::wait_free_queue/push_pop_latency",
+                by_payload<push_pop_latency_wait_free>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::queue/handoff", by_payload<handoff>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({2, 4, 8});
+    add("lf::wait_free_queue/handoff", by_payload<handoff_wait_free>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({2, 4, 8});
+    add("lf::queue/contended", by_payload<contended>)
+            .arg("payload", {8})
+            .arg("capacity", {1024})
+            .threads({2, 4, 8, 16});
+    add("lf::baskets_queue/contended", by_payload<contended_baskets>)
+            .arg("payload", {8})
+            .arg("capacity", {1024})
+            .threads({2, 4, 8, 16});
+    add("lf::wait_free_queue/contended", by_payload<contended_wait_free>)
+            .arg("payload", {8})
+            .arg("capacity", {1024})
+            .threads({2, 4, 8, 16});
+});
+
+} // namespace
@@ -0,0 +1,81 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <mu/bench/bench.h>
+#include <mu/bench/containers.h>
+#include <mu/bench/payload.h>
+#include <mu/lf/stack.h>
+
+/// \c mu::lf::stack benchmarks.
+
+using namespace mu::bench;
+
+namespace {
+
+/// Each thread alternately pushes and pops elements of type \c P, in a
+/// stack storing nodes as \c Links specifies.
+template <typename P, typename Links = mu::lf::pointer_links>
+using push_pop_of = push_pop_in<mu::lf::stack<P, std::allocator<P>, Links>>;
+
+template <size_t N>
+using push_pop = push_pop_of<payload<N>>;
+
+/// As \c push_pop, with elements that aren't trivially copyable.
+template <size_t N>
+using push_pop_nontrivial = push_pop_of<nontrivial_payload<N>>;
+
+/// As \c push_pop, with nodes linked by 32-bit slab indices.
+template <size_t N>
+using push_pop_indexed = push_pop_of<payload<N>, mu::lf::index_links>;
+
+/// Even threads produce and odd threads consume.
+template <size_t N>
+using produce_consume = produce_consume_in<mu::lf::stack<payload<N>>>;
+
+/// As \c push_pop, recording the latency of each push and of each pop,
+/// including any retries of the latter.
+template <size_t N>
+using push_pop_latency = push_pop_latency_in<mu::lf::stack<payload<N>>>;
+
+/// As \c produce_consume, recording the latency from before each push to
+/// after the pop of the pushed element, carried as the element's ID.
+template <size_t N>
+using handoff = handoff_in<mu::lf::stack<payload<N>>>;
+
+/// Each thread alternately pushes and pops, recording the latency of each
+/// push and pop pair and the retries it took.
+template <size_t N>
+using contended = contended_in<mu::lf::stack<payload<N>>>;
+
+registrar _([] {
+    add("lf::stack/push_pop", by_payload<push_pop>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::stack/push_pop_nontrivial", by_payload<push_pop_nontrivial>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::stack/push_pop_indexed", by_payload<push_pop_indexed>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::stack/produce_consume", by_payload<produce_consume>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({2, 4, 8});
+    add("lf::stack/push_pop_latency", by_payload<push_pop_latency>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({1, 2, 4, 8});
+    add("lf::stack/handoff", by_payload<handoff>)
+            .arg("payload", payload_sizes)
+            .arg("capacity", {1024, 65536})
+            .threads({2, 4, 8});
+    add("lf::stack/contended", by_payload<contended>)
+            .arg("payload", {8})
+            .arg("capacity", {1024})
+            .threads({2, 4, 8, 16});
+});
+
+} // namespace
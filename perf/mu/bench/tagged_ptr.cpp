@@ -0,0 +1,118 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <atomic>
+
+#include <mu/bench/bench.h>
+#include <mu/tagged_ptr.h>
+
+/// \c mu::tagged_ptr benchmarks.
+
+using namespace mu::bench;
+using mu::tagged_ptr;
+using mu::tagged_value;
+
+namespace {
+
+/// Each thread increments the tag of a shared pointer by compare and set,
+/// counting failed attempts.
+class increment_tag : public fixture {
+public:
+    increment_tag(const arguments&, size_t) : p_(&value_) {}
+
+    void run(context& c) override
+    {
+        size_t failures = 0;
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            while (true) {
+                tagged_ptr<size_t> expected(p_);
+                if (p_.compare_set_strong(expected, expected.increment_tag()))
+                    break;
+                ++failures;
+            }
+        }
+        c.count("cas_failures", failures);
+    }
+
+private:
+    size_t value_;
+    tagged_ptr<size_t> p_;
+};
+
+/// As \c increment_tag, snapshotting the pointer as a \c tagged_value so each
+/// attempt performs a single atomic load.
+class increment_tag_snapshot : public fixture {
+public:
+    increment_tag_snapshot(const arguments&, size_t) : p_(&value_) {}
+
+    void run(context& c) override
+    {
+        size_t failures = 0;
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            while (true) {
+                const tagged_value<size_t> expected = p_.load();
+                if (p_.compare_set_strong(expected, expected.increment_tag()))
+                    break;
+                ++failures;
+            }
+        }
+        c.count("cas_failures", failures);
+    }
+
+private:
+    size_t value_;
+    tagged_ptr<size_t> p_;
+};
+
+/// Each thread dereferences and reads the tag of a shared pointer.
+class read : public fixture {
+public:
+    read(const arguments&, size_t) : value_(1), p_(&value_), sink_(0) {}
+
+    void run(context& c) override
+    {
+        size_t sum = 0;
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            sum += *p_ + p_.get_tag();
+        }
+        sink_ += sum;
+    }
+
+private:
+    size_t value_;
+    tagged_ptr<size_t> p_;
+    std::atomic<size_t> sink_;      // Consumes the reads.
+};
+
+/// As \c read, from a single load of the pointer into a \c tagged_value.
+class read_snapshot : public fixture {
+public:
+    read_snapshot(const arguments&, size_t) : value_(1), p_(&value_), sink_(0)
+    {
+    }
+
+    void run(context& c) override
+    {
+        size_t sum = 0;
+        for (size_t i = 0; i < c.iterations(); ++i) {
+            const tagged_value<size_t> v = p_.load();
+            sum += *v + v.get_tag();
+        }
+        sink_ += sum;
+    }
+
+private:
+    size_t value_;
+    tagged_ptr<size_t> p_;
+    std::atomic<size_t> sink_;      // Consumes the reads.
+};
+
+registrar _([] {
+    add<increment_tag>("tagged_ptr/increment_tag").threads({1, 2, 4, 8});
+    add<increment_tag_snapshot>("tagged_ptr/increment_tag_snapshot")
+            .threads({1, 2, 4, 8});
+    add<read>("tagged_ptr/read").threads({1, 2, 4, 8});
+    add<read_snapshot>("tagged_ptr/read_snapshot").threads({1, 2, 4, 8});
+});
+
+} // namespace
@@ -0,0 +1,249 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <mu/adt/heap.h>
+#include <mu/lf/queue.h>
+#include <mu/lf/stack.h>
+
+/// Benchmark the memory footprint and allocations of the containers with the
+/// following runtime parameters
+///
+/// - steady state number of elements, also the initial capacity
+/// - burst factor, the multiple of the steady state pushed in a burst
+///
+/// Global \c operator \c new and \c operator \c delete are replaced to count
+/// allocations and live heap bytes, and the resident set size is read from \c
+/// /proc/self/statm.  Each container of \c size_t is measured after
+/// construction, in a steady state of alternating pushes and pops, after a
+/// burst of pushes and after popping back to the steady state, reporting
+/// allocations and deallocations per operation and heap bytes per element
+/// held.  Pooled nodes, e.g. \c mu::lf::queue's free list, are retained after
+/// a burst so the post-burst footprint reflects the peak.  The resident set
+/// size only grows as the allocator reuses memory freed by earlier containers.
+
+using namespace std;
+
+namespace {
+
+/// Allocation counts and live bytes over all threads.
+atomic<uint64_t> g_allocations(0);
+atomic<uint64_t> g_deallocations(0);
+atomic<int64_t> g_live_bytes(0);
+
+/// Each allocation is prefixed with its size, preserving alignment.
+constexpr static const size_t HEADER_SIZE = alignof(max_align_t);
+
+void* allocate(size_t size)
+{
+    void* p = malloc(HEADER_SIZE + size);
+    if (p == nullptr)
+        throw bad_alloc();
+    *static_cast<size_t*>(p) = size;
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    g_live_bytes.fetch_add(static_cast<int64_t>(size), memory_order_relaxed);
+    return static_cast<char*>(p) + HEADER_SIZE;
+}
+
+void deallocate(void* p) noexcept
+{
+    if (p == nullptr)
+        return;
+    void* q = static_cast<char*>(p) - HEADER_SIZE;
+    g_deallocations.fetch_add(1, memory_order_relaxed);
+    g_live_bytes.fetch_sub(
+            static_cast<int64_t>(*static_cast<size_t*>(q)),
+            memory_order_relaxed);
+    free(q);
+}
+
+} // namespace
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+
+namespace {
+
+/// \return the resident set size in bytes, or zero if unavailable.
+uint64_t resident_bytes()
+{
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == nullptr)
+        return 0;
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    const int n = fscanf(f, "%llu %llu", &size, &resident);
+    fclose(f);
+    if (n != 2)
+        return 0;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+/// A snapshot of the counts, for measuring phases by difference.
+struct snapshot {
+    snapshot() :
+            allocations(g_allocations.load()),
+            deallocations(g_deallocations.load()),
+            live_bytes(g_live_bytes.load()),
+            resident(resident_bytes())
+    {
+    }
+
+    uint64_t allocations;
+    uint64_t deallocations;
+    int64_t live_bytes;
+    uint64_t resident;
+};
+
+/// Report a phase of \c operations, at \c occupancy elements afterwards,
+/// since \c phase, and the footprint since \c baseline.
+void report(
+        const string& container,
+        const string& phase,
+        size_t operations,
+        size_t occupancy,
+        const snapshot& baseline,
+        const snapshot& start)
+{
+    const snapshot now;
+    const auto per = [](double n, size_t d) { return d > 0 ? n / d : 0; };
+    const int64_t bytes = now.live_bytes - baseline.live_bytes;
+    const int64_t resident = static_cast<int64_t>(now.resident) -
+            static_cast<int64_t>(baseline.resident);
+    cout << left << setw(16) << container << setw(14) << phase << right
+            << setw(12) << occupancy
+            << fixed << setprecision(3)
+            << setw(12) << per(now.allocations - start.allocations, operations)
+            << setw(12)
+            << per(now.deallocations - start.deallocations, operations)
+            << setw(14) << bytes
+            << setprecision(1) << setw(12) << per(bytes, occupancy)
+            << setw(14) << resident / 1024 << endl;
+}
+
+/// Measure the phases of a container \c C, constructed by \c make, with \c
+/// push and \c pop adapting its interface.
+template <typename C, typename Make, typename Push, typename Pop>
+void measure(
+        const string& name,
+        size_t element_count,
+        size_t burst_factor,
+        Make make,
+        Push push,
+        Pop pop)
+{
+    const snapshot baseline;
+    {
+        snapshot start;
+        C* c = make(element_count);
+        report(name, "construct", 1, 0, baseline, start);
+
+        start = snapshot();
+        for (size_t i = 0; i < element_count; ++i) {
+            push(*c, i);
+        }
+        report(name, "fill", element_count, element_count, baseline, start);
+
+        start = snapshot();
+        for (size_t i = 0; i < element_count; ++i) {
+            push(*c, i);
+            pop(*c);
+        }
+        report(name, "steady", 2 * element_count, element_count, baseline,
+                start);
+
+        const size_t burst = burst_factor * element_count;
+        start = snapshot();
+        for (size_t i = 0; i < burst; ++i) {
+            push(*c, i);
+        }
+        report(name, "burst", burst, element_count + burst, baseline, start);
+
+        start = snapshot();
+        for (size_t i = 0; i < burst; ++i) {
+            pop(*c);
+        }
+        report(name, "post-burst", burst, element_count, baseline, start);
+
+        start = snapshot();
+        for (size_t i = 0; i < element_count; ++i) {
+            push(*c, i);
+            pop(*c);
+        }
+        report(name, "steady", 2 * element_count, element_count, baseline,
+                start);
+
+        start = snapshot();
+        for (size_t i = 0; i < element_count; ++i) {
+            pop(*c);
+        }
+        report(name, "drain", element_count, 0, baseline, start);
+
+        start = snapshot();
+        delete c;
+        report(name, "destroy", 1, 0, baseline, start);
+    }
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " ELEMENTS [BURST_FACTOR]";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    long long element_count = atoll(argv[1]);
+    long long burst_factor = argc > 2 ? atoll(argv[2]) : 4;
+    if (element_count < 1 || burst_factor < 1) {
+        cerr << "parameters must each be > 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    const auto n = static_cast<size_t>(element_count);
+    const auto b = static_cast<size_t>(burst_factor);
+
+    cout << left << setw(16) << "container" << setw(14) << "phase" << right
+            << setw(12) << "elements" << setw(12) << "allocs/op"
+            << setw(12) << "frees/op" << setw(14) << "heap bytes"
+            << setw(12) << "bytes/elem" << setw(14) << "rss delta KB"
+            << endl;
+
+    using queue = mu::lf::queue<size_t>;
+    measure<queue>("mu::lf::queue", n, b,
+            [](size_t capacity) { return new queue(capacity); },
+            [](queue& q, size_t i) { q.push(i); },
+            [](queue& q) { size_t e; q.pop(e); });
+
+    using stack = mu::lf::stack<size_t>;
+    measure<stack>("mu::lf::stack", n, b,
+            [](size_t capacity) { return new stack(capacity); },
+            [](stack& s, size_t i) { s.push(i); },
+            [](stack& s) { size_t e; s.pop(e); });
+
+    using heap = mu::adt::heap<size_t>;
+    measure<heap>("mu::adt::heap", n, b,
+            [](size_t) { return new heap(); },
+            [](heap& h, size_t i) { h.push(i); },
+            [](heap& h) { h.pop(); });
+    return 0;
+}
@@ -0,0 +1,133 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <mu/lf/provision.h>
+#include <mu/lf/queue.h>
+#include <mu/lf/stack.h>
+
+/// Benchmark the construction and warm-up of the lock-free containers with
+/// the following runtime parameters
+///
+/// - initial capacities
+///
+/// For \c mu::lf::queue and \c mu::lf::stack of \c size_t, and each \c
+/// mu::lf::provision, the following are reported
+///
+/// - the constructor's time and minor page faults, i.e. first touches
+/// - the time to the first push
+/// - the mean time per push to fill the initial capacity, and its page faults
+/// - the time to destroy the emptied container
+///
+/// Lazy provisioning moves the cost of construction into the first pushes of
+/// each batch, and parallel provisioning divides it between CPUs.
+
+using namespace std;
+using mu::lf::provision;
+
+namespace {
+
+/// \return the minor page faults of the process so far.
+long minor_faults()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+double since(const chrono::steady_clock::time_point& start)
+{
+    return chrono::duration<double, nano>(
+            chrono::steady_clock::now() - start).count();
+}
+
+/// Measure the construction and warm-up of a container \c C.
+template <typename C>
+void measure(const string& name, provision p, size_t capacity)
+{
+    long faults = minor_faults();
+    auto start = chrono::steady_clock::now();
+    C* c = new C(capacity, p);
+    const double construct_ns = since(start);
+    const long construct_faults = minor_faults() - faults;
+
+    start = chrono::steady_clock::now();
+    c->push(0);
+    const double first_ns = since(start);
+
+    faults = minor_faults();
+    start = chrono::steady_clock::now();
+    for (size_t i = 1; i < capacity; ++i) {
+        c->push(i);
+    }
+    const double fill_ns = since(start);
+    const long fill_faults = minor_faults() - faults;
+
+    size_t e;
+    while (c->pop(e)) {
+    }
+    start = chrono::steady_clock::now();
+    delete c;
+    const double destroy_ns = since(start);
+
+    const char* const provisions[] = {"eager", "parallel", "lazy"};
+    cout << left << setw(16) << name << setw(10)
+            << provisions[static_cast<int>(p)] << right
+            << setw(12) << capacity
+            << fixed << setprecision(3)
+            << setw(14) << construct_ns / 1e6
+            << setw(10) << construct_faults
+            << setprecision(0) << setw(12) << first_ns
+            << setprecision(1)
+            << setw(10) << (capacity > 1 ? fill_ns / (capacity - 1) : 0)
+            << setw(10) << fill_faults
+            << setprecision(3) << setw(12) << destroy_ns / 1e6 << endl;
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " CAPACITY...";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    vector<size_t> capacities;
+    for (int i = 1; i < argc; ++i) {
+        const long long capacity = atoll(argv[i]);
+        if (capacity < 1) {
+            cerr << "CAPACITY must be > 0" << endl;
+            cerr << usage(argv[0]) << endl;
+            exit(1);
+        }
+        capacities.push_back(static_cast<size_t>(capacity));
+    }
+
+    cout << left << setw(16) << "container" << setw(10) << "provision"
+            << right << setw(12) << "capacity" << setw(14) << "construct ms"
+            << setw(10) << "faults" << setw(12) << "1st push ns"
+            << setw(10) << "fill ns" << setw(10) << "faults"
+            << setw(12) << "destroy ms" << endl;
+    for (auto capacity : capacities) {
+        for (auto p : {provision::eager, provision::parallel,
+                provision::lazy}) {
+            measure<mu::lf::queue<size_t>>("mu::lf::queue", p, capacity);
+            measure<mu::lf::stack<size_t>>("mu::lf::stack", p, capacity);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/queue.h>
+#include <mu/tagged_ptr.h>
+
+/// Benchmark the one way handoff latency between every pair of CPUs with the
+/// following runtime parameters
+///
+/// - round trips per pair
+/// - CPUs, defaulting to all
+///
+/// Two threads, pinned to the pair's CPUs, ping-pong by
+///
+/// - compare and setting a shared \c mu::tagged_ptr, each waiting for the
+///   other to increment the tag to its parity
+/// - pushing to and popping from \c mu::lf::queue instances of capacity one,
+///   one per direction
+///
+/// and the mean one way latency in nanoseconds, half the round trip, is
+/// written as a matrix per mechanism.  The latency varies with whether the
+/// CPUs are SMT siblings, share a last level cache or are on different sockets,
+/// so guides thread placement.
+
+using namespace std;
+
+/// \return \c true iff the calling thread was pinned to \c cpu.
+static bool pin(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void) cpu;
+    return false;
+#endif
+}
+
+/// A ping-pong between two threads, invoked on each with the player's index,
+/// 0 or 1, and the number of round trips to play.
+using game = function<void (size_t player, size_t round_trips)>;
+
+/// Play \c g on CPUs \c a and \c b, after a warmup.
+///
+/// \return the mean one way latency in nanoseconds, or a negative value if
+///         the threads couldn't be pinned.
+static double play(const game& g, int a, int b, size_t round_trips)
+{
+    atomic<size_t> ready(0);
+    atomic<bool> pinned(true);
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point stop;
+
+    const size_t warmup = round_trips / 10 + 1;
+    auto player = [&](size_t i, int cpu) {
+        if (!pin(cpu))
+            pinned = false;
+        g(i, warmup);
+
+        // Time from when both have warmed up, ready for the next round.
+        ++ready;
+        while (ready.load() < 2) {
+        }
+        if (i == 0)
+            start = chrono::steady_clock::now();
+        g(i, round_trips);
+        if (i == 0)
+            stop = chrono::steady_clock::now();
+    };
+    thread ta(player, 0, a);
+    thread tb(player, 1, b);
+    ta.join();
+    tb.join();
+
+    if (!pinned)
+        return -1;
+    return chrono::duration<double, nano>(stop - start).count() /
+            (2 * round_trips);
+}
+
+/// \return a game compare and setting the tag of a shared tagged pointer.
+///         Player 0 moves the tag from even to odd and player 1 back.
+static game tagged_ptr_game()
+{
+    auto p = make_shared<mu::tagged_ptr<int>>();
+    return [p](size_t player, size_t round_trips) {
+        for (size_t i = 0; i < round_trips; ++i) {
+            while (true) {
+                const mu::tagged_value<int> expected = p->load();
+                if (expected.get_tag() % 2 == player &&
+                        p->compare_set_strong(
+                                expected, expected.increment_tag())) {
+                    break;
+                }
+            }
+        }
+    };
+}
+
+/// \return a game handing an element to and fro over two queues.
+static game queue_game()
+{
+    using queue = mu::lf::queue<size_t>;
+    auto ping = make_shared<queue>(1);
+    auto pong = make_shared<queue>(1);
+    return [ping, pong](size_t player, size_t round_trips) {
+        size_t e = 0;
+        for (size_t i = 0; i < round_trips; ++i) {
+            if (player == 0) {
+                ping->push(i);
+                while (!pong->pop(e)) {
+                }
+            } else {
+                while (!ping->pop(e)) {
+                }
+                pong->push(e);
+            }
+        }
+    };
+}
+
+/// Write the matrix of one way latencies between \c cpus for games from \c
+/// make.
+static void matrix(
+        const string& name,
+        const function<game ()>& make,
+        const vector<int>& cpus,
+        size_t round_trips)
+{
+    const size_t n = cpus.size();
+    vector<vector<double>> latency(n, vector<double>(n, 0));
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            latency[i][j] = latency[j][i] =
+                    play(make(), cpus[i], cpus[j], round_trips);
+        }
+    }
+
+    cout << name << " one way latency (ns)" << endl;
+    cout << setw(6) << "cpu";
+    for (auto cpu : cpus) {
+        cout << setw(10) << cpu;
+    }
+    cout << endl;
+    cout << fixed << setprecision(1);
+    for (size_t i = 0; i < n; ++i) {
+        cout << setw(6) << cpus[i];
+        for (size_t j = 0; j < n; ++j) {
+            if (i == j)
+                cout << setw(10) << "-";
+            else if (latency[i][j] < 0)
+                cout << setw(10) << "n/a";
+            else
+                cout << setw(10) << latency[i][j];
+        }
+        cout << endl;
+    }
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " ROUND_TRIPS [CPU...]";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    long long round_trips = atoll(argv[1]);
+    if (round_trips < 1) {
+        cerr << "ROUND_TRIPS must be > 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+
+    vector<int> cpus;
+    for (int i = 2; i < argc; ++i) {
+        cpus.push_back(atoi(argv[i]));
+        if (cpus.back() < 0) {
+            cerr << "CPU must be >= 0" << endl;
+            cerr << usage(argv[0]) << endl;
+            exit(1);
+        }
+    }
+    if (cpus.empty()) {
+        for (unsigned i = 0; i < thread::hardware_concurrency(); ++i) {
+            cpus.push_back(static_cast<int>(i));
+        }
+    }
+    if (cpus.size() < 2) {
+        cerr << "at least 2 CPUs are required" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+
+    const auto n = static_cast<size_t>(round_trips);
+    matrix("mu::tagged_ptr", tagged_ptr_game, cpus, n);
+    matrix("mu::lf::queue", queue_game, cpus, n);
+    return 0;
+}
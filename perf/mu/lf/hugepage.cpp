@@ -0,0 +1,117 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <mu/bench/counters.h>
+#include <mu/hugepage_resource.h>
+#include <mu/lf/pmr.h>
+#include <mu/lf/queue.h>
+#include <mu/lf/stack.h>
+
+/// Benchmark walking container nodes allocated from base and huge pages with
+/// the following runtime parameters
+///
+/// - total number of elements, also the containers' initial capacity
+///
+/// Each container is filled and drained on a single thread, reporting the
+/// elapsed time and, per element, the dTLB read misses and other hardware
+/// events counted by \c perf_event_open, where available.  Nodes are allocated
+/// by \c std::allocator and by \c mu::hugepage_resource preferring each \c
+/// mu::page_backing.  Explicit huge pages require reservation, e.g. \c
+/// /proc/sys/vm/nr_hugepages.
+
+using namespace std;
+using mu::hugepage_resource;
+using mu::page_backing;
+
+static const char* to_string(page_backing b)
+{
+    switch (b) {
+    case page_backing::hugetlb:
+        return "hugetlb";
+    case page_backing::transparent:
+        return "transparent";
+    case page_backing::normal:
+        return "normal";
+    }
+    return "";
+}
+
+/// Fill and drain \c c, reporting the time taken and hardware events.
+template <typename Container>
+void walk(const string& name, Container& c, size_t element_count)
+{
+    mu::bench::counters hw;
+    const auto start = chrono::steady_clock::now();
+    hw.start();
+    for (size_t i = 0; i < element_count; ++i) {
+        c.push(i);
+    }
+    size_t consumed = 0;
+    while (c.pop()) {
+        ++consumed;
+    }
+    const auto counts = hw.stop();
+    const auto stop = chrono::steady_clock::now();
+    assert(consumed == element_count);
+
+    cout << name << " "
+            << chrono::duration_cast<chrono::milliseconds>(stop - start).count()
+            << " ms";
+    if (!hw.available())
+        cout << ", hardware counters unavailable";
+    for (const auto& count : counts) {
+        cout << ", " << static_cast<double>(count.second) / element_count
+                << " " << count.first << " per element";
+    }
+    cout << endl;
+}
+
+/// Walk a container allocating from \c std::allocator and from huge pages.
+template <typename Container, typename PmrContainer>
+void run(const string& name, size_t element_count)
+{
+    {
+        Container c(element_count);
+        walk(name + " std::allocator", c, element_count);
+    }
+
+    for (auto b : {page_backing::hugetlb,
+            page_backing::transparent,
+            page_backing::normal}) {
+        hugepage_resource r(b);
+        PmrContainer c(element_count, &r);
+        walk(name + " hugepage_resource(" + to_string(b) + "->" +
+                to_string(r.backing()) + ")", c, element_count);
+    }
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " ELEMENTS";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    long long element_count = atoll(argv[1]);
+    if (element_count < 1) {
+        cerr << "ELEMENTS must be > 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    const auto n = static_cast<size_t>(element_count);
+
+    run<mu::lf::queue<size_t>, mu::lf::pmr::queue<size_t>>("mu::lf::queue", n);
+    run<mu::lf::stack<size_t>, mu::lf::pmr::stack<size_t>>("mu::lf::stack", n);
+    return 0;
+}
@@ -0,0 +1,172 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/pmr.h>
+#include <mu/memory_resource.h>
+
+/// Benchmark lock-free containers allocating from polymorphic memory resources
+/// with the following runtime parameters
+///
+/// - producers (1 thread per producer)
+/// - consumers (1 thread per consumer)
+/// - total number of elements to produce
+/// - initial capacity, small values forcing node allocation under load
+///
+/// Each of \c mu::lf::pmr::queue and \c mu::lf::pmr::stack is run against the
+/// default (new/delete) resource, a \c synchronized_pool_resource and a \c
+/// monotonic_buffer_resource.  Each run's time includes construction,
+/// concurrent production and consumption, and destruction.
+///
+/// Requires the C++17 standard memory resources.
+
+using namespace std;
+
+#if !defined(MU_STD_PMR)
+#error "pmr-perf requires <memory_resource>"
+#endif
+
+/// Serialize access to an unsynchronized upstream resource.
+class locked_resource : public mu::pmr::memory_resource {
+public:
+    explicit locked_resource(mu::pmr::memory_resource* upstream) :
+            upstream_(upstream)
+    {
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        lock_guard<mutex> _(mutex_);
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        lock_guard<mutex> _(mutex_);
+        upstream_->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const memory_resource& o) const noexcept override
+    {
+        return this == &o;
+    }
+
+    mutex mutex_;
+    mu::pmr::memory_resource* upstream_;
+};
+
+/// Run producers and consumers against a container allocating from \c r.
+template <typename Container>
+void run(
+        const string& container_name,
+        const string& resource_name,
+        mu::pmr::memory_resource* r,
+        size_t producer_count,
+        size_t consumer_count,
+        size_t element_count,
+        size_t initial_capacity)
+{
+    const auto start = chrono::steady_clock::now();
+    {
+        Container c(initial_capacity, r);
+
+        vector<thread> threads;
+        for (size_t i = 0; i < producer_count; ++i) {
+            threads.emplace_back([&c, i, producer_count, element_count] {
+                const size_t count = element_count / producer_count;
+                for (size_t j = 0; j < count; ++j) {
+                    c.push(i * count + j);
+                }
+            });
+        }
+        for (size_t i = 0; i < consumer_count; ++i) {
+            threads.emplace_back([&c, consumer_count, element_count] {
+                const size_t count = element_count / consumer_count;
+                size_t consumed = 0;
+                while (consumed < count) {
+                    if (c.pop())
+                        ++consumed;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    const auto stop = chrono::steady_clock::now();
+
+    cout << container_name << " " << resource_name << " "
+            << chrono::duration_cast<chrono::milliseconds>(stop - start).count()
+            << " ms" << endl;
+}
+
+/// Run a container against each resource.
+template <typename Container>
+void run_all(const string& name, size_t p, size_t c, size_t n, size_t capacity)
+{
+    run<Container>(name, "new_delete_resource",
+            mu::pmr::new_delete_resource(), p, c, n, capacity);
+
+    mu::pmr::synchronized_pool_resource pool;
+    run<Container>(name, "synchronized_pool_resource", &pool, p, c, n, capacity);
+
+    // Monotonic buffers are not thread safe, but only lock on allocation.
+    mu::pmr::monotonic_buffer_resource monotonic;
+    locked_resource locked(&monotonic);
+    run<Container>(name, "monotonic_buffer_resource", &locked, p, c, n, capacity);
+}
+
+string usage(char const * const program)
+{
+        return string("usage: ") + program + " PRODUCERS CONSUMERS ELEMENTS "
+                "[INITIAL_CAPACITY]";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    int producer_count = atoi(argv[1]);
+    int consumer_count = atoi(argv[2]);
+    int element_count = atoi(argv[3]);
+    int initial_capacity = argc > 4 ? atoi(argv[4]) : 0;
+    if (producer_count < 1 || consumer_count < 1 || element_count < 1) {
+        cerr << "PRODUCERS, CONSUMERS and ELEMENTS must each be > 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    if (initial_capacity < 0) {
+        cerr << "INITIAL_CAPACITY must be >= 0" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    if (producer_count > element_count || consumer_count > element_count) {
+        cerr << "PRODUCERS and CONSUMERS must be <= ELEMENTS" << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+    if (element_count % producer_count || element_count % consumer_count) {
+        cerr << "ELEMENTS must be a multiple of PRODUCERS and CONSUMERS"
+                << endl;
+        cerr << usage(argv[0]) << endl;
+        exit(1);
+    }
+
+    const auto p = static_cast<size_t>(producer_count);
+    const auto c = static_cast<size_t>(consumer_count);
+    const auto n = static_cast<size_t>(element_count);
+    const auto capacity = static_cast<size_t>(initial_capacity);
+    run_all<mu::lf::pmr::queue<size_t>>("mu::lf::pmr::queue", p, c, n, capacity);
+    run_all<mu::lf::pmr::stack<size_t>>("mu::lf::pmr::stack", p, c, n, capacity);
+    return 0;
+}
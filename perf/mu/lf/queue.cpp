@@ -1,12 +1,29 @@
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <iomanip>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include <mu/bench/counters.h>
+#include <mu/bench/fairness.h>
+#include <mu/histogram.h>
+#include <mu/lf/baskets_queue.h>
 #include <mu/lf/queue.h>
+#include <mu/lf/sharded_queue.h>
+#include <mu/lf/stats.h>
+#include <mu/lf/two_lock_queue.h>
+#include <mu/lf/wait_free_queue.h>
 
 using namespace std;
 
@@ -16,20 +33,49 @@ using namespace std;
 /// - producers (1 thread per producer)
 /// - total number of elements to produce
 /// - iterations against a single queue
+/// - offered loads, in elements per second over all producers
+///
+/// Without an offered load producers push as fast as possible (closed loop),
+/// which hides queueing delay.  With offered loads each is run in turn (open
+/// loop): producers push at the load's rate following a precomputed schedule
+/// of intended send times, and consumers record the latency from each
+/// element's intended, rather than actual, send time.  A producer falling
+/// behind schedule pushes immediately, so its delay is included rather than
+/// omitted.  Sweeping the load locates the queue's saturation knee, where
+/// achieved throughput stops tracking the offered load and latency climbs.
+///
+/// Closed loop runs also report hardware events per element, counted by \c
+/// perf_event_open over all producer and consumer threads, where available.
+/// Each thread reports its operations, longest wait for an operation and, with
+/// \c MU_LF_STATS, retries in the queue, and Jain's fairness index of the
+/// producers' and consumers' throughputs is reported per iteration, exposing
+/// threads starved by losing compare and set races.
+///
+/// The sweep mode instead runs each combination of producer and consumer
+/// counts, in powers of two up to a maximum, element payload size and initial
+/// capacity.  Threads are pinned to CPUs round robin and released together by
+/// a barrier.  Each combination is written as a CSV row of throughput and
+/// push to pop latency percentiles, giving comparable scaling curves across
+/// machines and queue implementations.
 
 struct foo {
-    foo() : id_(0) {}
-    foo(size_t id) : id_(id) {}
+    foo() : id_(0), intended_(0) {}
+    foo(size_t id) : id_(id), intended_(0) {}
+    foo(size_t id, uint64_t intended) : id_(id), intended_(intended) {}
     foo(const foo&) = default;
-    foo(foo&& f) : id_(f.id_) {}
+    foo(foo&&) = default;
 
     foo& operator=(const foo&) = default;
-    foo& operator=(foo&& lhs) { id_ = lhs.id_; return *this; }
+    foo& operator=(foo&&) = default;
     bool operator==(foo const& lhs) const { return id_ == lhs.id_; }
 
     size_t id_;
+    uint64_t intended_;     // Intended send time, open loop only.
 };
 
+// Measure the queues' trivially copyable path.
+static_assert(mu::lf::impl::is_trivial_value<foo>::value, "");
+
 #ifdef BOOST_LFQ
 
 #include <boost/lockfree/queue.hpp>
@@ -37,7 +83,11 @@ struct foo {
 template<typename T>
 class boost_lfq_wrapper {
 public:
-    boost_lfq_wrapper() : q_(mu::lf::queue<T>::DEFAULT_INITIAL_CAPACITY) {}
+    explicit boost_lfq_wrapper(
+            size_t capacity = mu::lf::queue<T>::DEFAULT_INITIAL_CAPACITY) :
+            q_(capacity)
+    {
+    }
 
     mu::optional<T> pop()
     {
@@ -61,7 +111,9 @@ private:
 template<typename T>
 class locking_queue {
 public:
-    locking_queue() : q_(mu::lf::queue<T>::DEFAULT_INITIAL_CAPACITY)
+    explicit locking_queue(
+            size_t capacity = mu::lf::queue<T>::DEFAULT_INITIAL_CAPACITY) :
+            q_(capacity)
     {
         q_.resize(0);  // Reduce size, but not, necessarily, capacity.
     }
@@ -99,20 +151,72 @@ private:
 };
 
 #if defined(BOOST_LFQ)
-using queue boost_lfq_wrapper<foo>;
+template <typename T> using queue_type = boost_lfq_wrapper<T>;
 constexpr static const char* g_queue_type = "boost::lockfree::queue";
 #elif defined(LOCKING)
-using queue = locking_queue<foo>;
+template <typename T> using queue_type = locking_queue<T>;
 constexpr static const char* g_queue_type = "locking_queue";
+#elif defined(TWO_LOCK)
+template <typename T> using queue_type = mu::lf::two_lock_queue<T>;
+constexpr static const char* g_queue_type = "mu::lf::two_lock_queue";
+#elif defined(TWO_LOCK_MCS)
+template <typename T>
+using queue_type = mu::lf::two_lock_queue<T, mu::mcs_spinlock>;
+constexpr static const char* g_queue_type =
+        "mu::lf::two_lock_queue<mcs_spinlock>";
+#elif defined(BASKETS)
+template <typename T> using queue_type = mu::lf::baskets_queue<T>;
+constexpr static const char* g_queue_type = "mu::lf::baskets_queue";
+#elif defined(WAIT_FREE)
+template <typename T> using queue_type = mu::lf::wait_free_queue<T>;
+constexpr static const char* g_queue_type = "mu::lf::wait_free_queue";
+#elif defined(SHARDED)
+template <typename T> using queue_type = mu::lf::sharded_queue<T>;
+constexpr static const char* g_queue_type = "mu::lf::sharded_queue";
 #else
-using queue = mu::lf::queue<foo>;
+template <typename T> using queue_type = mu::lf::queue<T>;
 constexpr static const char* g_queue_type = "mu::lf::queue";
 #endif
 
+using queue = queue_type<foo>;
+
 // Synchronize output stream operations.
 static mutex g_io_mutex;
 
-void produce(size_t element_count, size_t id_offset, queue& q)
+/// \return a monotonic timestamp in nanoseconds.
+static uint64_t now()
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// A closed loop producer's or consumer's measurements.
+struct thread_report {
+    size_t operations = 0;      // Successful pushes or pops.
+    size_t empty_pops = 0;
+    uint64_t retries = 0;       // In the queue, with MU_LF_STATS.
+    uint64_t max_wait = 0;      // Longest for an operation to succeed, ns.
+    uint64_t elapsed = 0;       // ns.
+
+    double operations_per_sec() const
+    {
+        return elapsed > 0 ? operations * 1e9 / elapsed : 0;
+    }
+};
+
+/// \return a description of \c r.
+string to_string(const thread_report& r)
+{
+    return to_string(r.elapsed / 1000) + " us, max wait " +
+            to_string(r.max_wait / 1000) + " us, " +
+            to_string(r.retries) + " retries";
+}
+
+void produce(
+        size_t element_count,
+        size_t id_offset,
+        queue& q,
+        thread_report& r)
 {
     size_t id = id_offset;
 
@@ -121,33 +225,99 @@ void produce(size_t element_count, size_t id_offset, queue& q)
         cout << this_thread::get_id() << " - produce from ID " << id << endl;
     }
 
+    const uint64_t retries = mu::lf::thread_stats().retries;
+    const uint64_t start = now();
+    uint64_t last = start;
     for (size_t i = 0; i < element_count; ++i) {
         q.push(id++);
+        const uint64_t t = now();
+        r.max_wait = max(r.max_wait, t - last);
+        last = t;
     }
     --id;
+    r.operations = element_count;
+    r.elapsed = last - start;
+    r.retries = mu::lf::thread_stats().retries - retries;
 
     {
         lock_guard<mutex> _(g_io_mutex);
-        cout << this_thread::get_id() << " - produced to ID " << id << endl;
+        cout << this_thread::get_id() << " - produced to ID " << id
+                << " in " << to_string(r) << endl;
+    }
+}
+
+/// Push the elements at their intended send times, \c start plus the
+/// respective \c schedule offset.
+void produce_open_loop(
+        size_t id_offset,
+        const vector<uint64_t>& schedule,
+        uint64_t start,
+        queue& q)
+{
+    size_t id = id_offset;
+    for (auto offset : schedule) {
+        const uint64_t intended = start + offset;
+        while (now() < intended) {
+        }
+        q.push(foo(id++, intended));
+    }
+}
+
+/// Pop elements, recording the latency from their intended send times.
+void consume_open_loop(
+        size_t element_count,
+        queue& q,
+        vector<size_t>& consumed,
+        mu::histogram& latency)
+{
+    size_t attempt_count = 0;
+    size_t consumed_count = 0;
+    while (consumed_count < element_count) {
+        mu::optional<foo> e = q.pop();
+        if (e) {
+            latency.record(now() - e->intended_);
+            ++consumed_count;
+            attempt_count = 0;
+            consumed[e->id_] = true;
+        } else {
+            ++attempt_count;
+            if (attempt_count > 1000'000'000) {
+                lock_guard<mutex> _(g_io_mutex);
+                cerr << this_thread::get_id() << " - timed out on pop" << endl;
+                cerr << this_thread::get_id() << " - stopping" << endl;
+                return;
+            }
+        }
     }
 }
 
-void consume(size_t element_count, queue& q, vector<size_t>& consumed)
+void consume(
+        size_t element_count,
+        queue& q,
+        vector<size_t>& consumed,
+        thread_report& r)
 {
     {
         lock_guard<mutex> _(g_io_mutex);
         cout << this_thread::get_id() << " - consume" << endl;
     }
 
+    const uint64_t retries = mu::lf::thread_stats().retries;
+    const uint64_t start = now();
+    uint64_t last = start;
     size_t attempt_count = 0;
     size_t consumed_count = 0;
     while (consumed_count < element_count) {
         mu::optional<foo> e = q.pop();
         if (e) {
+            const uint64_t t = now();
+            r.max_wait = max(r.max_wait, t - last);
+            last = t;
             ++consumed_count;
             attempt_count = 0;
             consumed[e->id_] = true;
         } else {
+            ++r.empty_pops;
             ++attempt_count;
             if (attempt_count > 1000'000'000) {
                 cerr << this_thread::get_id() << " - timed out on pop" << endl;
@@ -156,47 +326,120 @@ void consume(size_t element_count, queue& q, vector<size_t>& consumed)
             }
         }
     }
+    r.operations = consumed_count;
+    r.elapsed = last - start;
+    r.retries = mu::lf::thread_stats().retries - retries;
 
     {
         lock_guard<mutex> _(g_io_mutex);
         cout << this_thread::get_id() << " - consumed "
-                << consumed_count << endl;
+                << consumed_count << " in " << to_string(r) << ", "
+                << r.empty_pops << " empty pops" << endl;
+    }
+}
+
+/// \return Jain's fairness index of the threads' throughputs.
+double fairness(const vector<thread_report>& rs)
+{
+    vector<double> xs;
+    for (const auto& r : rs) {
+        xs.push_back(r.operations_per_sec());
     }
+    return mu::bench::jain_index(xs);
+}
+
+/// Report an open loop run's achieved throughput and latency percentiles.
+void report_open_loop(
+        double rate,
+        size_t element_count,
+        uint64_t elapsed,
+        const mu::histogram& latency)
+{
+    cout << fixed << setprecision(0)
+            << setw(14) << rate
+            << setw(14) << element_count * 1e9 / elapsed
+            << setw(12) << latency.percentile(50)
+            << setw(12) << latency.percentile(90)
+            << setw(12) << latency.percentile(99)
+            << setw(12) << latency.percentile(99.9)
+            << setw(12) << latency.percentile(99.99)
+            << setw(12) << latency.max() << endl;
 }
 
+/// Run producers and consumers against a queue.
+///
+/// \param rate The offered load in elements per second, or zero for closed
+///        loop.
 void test_concurrent_producers_consumers(
         size_t producer_count,
         size_t consumer_count,
         size_t element_count,
-        size_t iterations)
+        size_t iterations,
+        double rate)
 {
     // The queue instance to test.
     queue q;
 
-    for (size_t i = 0; i < iterations; ++i) {
-        size_t count_per_consumer = element_count / consumer_count;
-        size_t count_per_producer = element_count / producer_count;
+    // Producers push equal shares and consumers pop all they push.
+    const size_t count_per_producer = element_count / producer_count;
+    const size_t total = count_per_producer * producer_count;
 
-        // Track consumed IDs.
-        vector<size_t> consumed;
-        consumed.reserve(element_count);
-        for (size_t j = 0; j < element_count; ++j) {
-            consumed[j] = 0;
+    // Each producer's intended send times, relative to a common start, with
+    // the producers' sends interleaved for a uniform rate overall.
+    vector<vector<uint64_t>> schedules(producer_count);
+    if (rate > 0) {
+        for (size_t j = 0; j < producer_count; ++j) {
+            for (size_t k = 0; k < count_per_producer; ++k) {
+                schedules[j].push_back(static_cast<uint64_t>(
+                        (k * producer_count + j) * 1e9 / rate));
+            }
         }
+    }
+
+    mu::histogram latency;
+    uint64_t elapsed = 0;
+
+    // Count the hardware events of the threads created.
+    mu::bench::counters hw(true);
+    hw.start();
+
+    for (size_t i = 0; i < iterations; ++i) {
+        // Track consumed IDs.
+        vector<size_t> consumed(element_count, 0);
+
+        // Start open loop schedules once all threads are likely running.
+        const uint64_t start = now() + 10'000'000;
+        vector<unique_ptr<mu::histogram>> latencies;
+        vector<thread_report> producer_reports(producer_count);
+        vector<thread_report> consumer_reports(consumer_count);
 
         // Produce.
         vector<thread> producers;
         for (size_t j = 0; j < producer_count; ++j) {
-            size_t offset = (element_count / producer_count) * j;
-            producers.emplace_back(
-                    thread(produce, count_per_producer, offset, ref(q)));
+            size_t offset = count_per_producer * j;
+            if (rate > 0) {
+                producers.emplace_back(thread(produce_open_loop,
+                        offset, cref(schedules[j]), start, ref(q)));
+            } else {
+                producers.emplace_back(thread(produce, count_per_producer,
+                        offset, ref(q), ref(producer_reports[j])));
+            }
         }
 
         // Consume.
         vector<thread> consumers;
         for (size_t j = 0; j < consumer_count; ++j) {
-            consumers.emplace_back(
-                    thread(consume, count_per_consumer, ref(q), ref(consumed)));
+            const size_t count = total / consumer_count +
+                    (j < total % consumer_count ? 1 : 0);
+            if (rate > 0) {
+                latencies.emplace_back(new mu::histogram);
+                consumers.emplace_back(thread(consume_open_loop,
+                        count, ref(q), ref(consumed),
+                        ref(*latencies.back())));
+            } else {
+                consumers.emplace_back(thread(consume, count,
+                        ref(q), ref(consumed), ref(consumer_reports[j])));
+            }
         }
 
         // Wait.
@@ -206,10 +449,19 @@ void test_concurrent_producers_consumers(
         for (auto &t : producers) {
             t.join();
         }
+        if (rate > 0) {
+            elapsed += now() - start;
+            for (const auto& l : latencies) {
+                latency.merge(*l);
+            }
+        } else {
+            cout << "fairness: producers " << fairness(producer_reports)
+                    << ", consumers " << fairness(consumer_reports) << endl;
+        }
 
         // Verify.
         bool found_unconsumed = false;
-        for (size_t j = 0; j < element_count; ++j) {
+        for (size_t j = 0; j < total; ++j) {
             if (!consumed[j]) {
                 if (!found_unconsumed) {
                     cerr << "unconsumed: ";
@@ -227,17 +479,184 @@ void test_concurrent_producers_consumers(
         assert(q.empty());
     }
 
+    const auto counts = hw.stop();
+    if (rate > 0) {
+        report_open_loop(rate, total * iterations, elapsed, latency);
+        return;
+    }
+
     cout << "capacity " << q.capacity() << endl;
+    if (!hw.available())
+        cout << "hardware counters unavailable" << endl;
+    for (const auto& count : counts) {
+        cout << count.first << " " << static_cast<double>(count.second) /
+                (total * iterations) << " per element" << endl;
+    }
+}
+
+/// A sweep element of \c N bytes carrying the time it was pushed.
+template <size_t N>
+struct timed {
+    static_assert(N > sizeof(uint64_t), "timed element too small");
+
+    timed() : pushed_(0) {}
+    explicit timed(uint64_t pushed) : pushed_(pushed) {}
+
+    uint64_t pushed_;
+    char padding_[N - sizeof(uint64_t)];
+};
+
+/// Release a number of threads together.
+class start_barrier {
+public:
+    explicit start_barrier(size_t count) : count_(count), waiting_(0) {}
+
+    /// Wait until \c count threads have called \c wait.
+    void wait()
+    {
+        ++waiting_;
+        while (waiting_.load() < count_) {
+            this_thread::yield();
+        }
+    }
+
+private:
+    const size_t count_;
+    atomic<size_t> waiting_;
+};
+
+/// Pin the calling thread to CPU \c i modulo the number of CPUs, where
+/// supported.
+void pin(size_t i)
+{
+#if defined(__linux__)
+    const size_t cpu_count = max<size_t>(1, thread::hardware_concurrency());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(i % cpu_count, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+    (void) i;
+#endif
+}
+
+/// Run producers and consumers of \c N byte elements against a queue of the
+/// given initial capacity and write the results as a CSV row.
+template <size_t N>
+void sweep_point(
+        size_t producer_count,
+        size_t consumer_count,
+        size_t capacity,
+        size_t element_count)
+{
+    using element = timed<N>;
+    queue_type<element> q(capacity);
+
+    // Producers push equal shares and consumers pop all they push.
+    const size_t count_per_producer = element_count / producer_count;
+    const size_t total = count_per_producer * producer_count;
+
+    vector<unique_ptr<mu::histogram>> latencies;
+    for (size_t j = 0; j < consumer_count; ++j) {
+        latencies.emplace_back(new mu::histogram);
+    }
+
+    start_barrier barrier(producer_count + consumer_count + 1);
+    vector<thread> threads;
+    for (size_t j = 0; j < producer_count; ++j) {
+        threads.emplace_back([&, j] {
+            pin(j);
+            barrier.wait();
+            for (size_t k = 0; k < count_per_producer; ++k) {
+                q.push(element(now()));
+            }
+        });
+    }
+    for (size_t j = 0; j < consumer_count; ++j) {
+        const size_t count = total / consumer_count +
+                (j < total % consumer_count ? 1 : 0);
+        threads.emplace_back([&, j, count] {
+            pin(producer_count + j);
+            mu::histogram& latency = *latencies[j];
+            barrier.wait();
+            for (size_t k = 0; k < count; ) {
+                mu::optional<element> e = q.pop();
+                if (e) {
+                    latency.record(now() - e->pushed_);
+                    ++k;
+                }
+            }
+        });
+    }
+
+    barrier.wait();
+    const uint64_t start = now();
+    for (auto& t : threads) {
+        t.join();
+    }
+    const uint64_t elapsed = now() - start;
+    assert(q.empty());
+
+    mu::histogram latency;
+    for (const auto& l : latencies) {
+        latency.merge(*l);
+    }
+    cout << g_queue_type << "," << producer_count << "," << consumer_count
+            << "," << N << "," << capacity << "," << total
+            << "," << fixed << setprecision(0) << total * 1e9 / elapsed
+            << "," << latency.percentile(50)
+            << "," << latency.percentile(90)
+            << "," << latency.percentile(99)
+            << "," << latency.percentile(99.9)
+            << "," << latency.percentile(99.99)
+            << "," << latency.max() << endl;
+}
+
+/// Sweep producer and consumer counts up to \c max_thread_count, payload
+/// sizes and initial capacities, writing CSV to standard output.
+void sweep(size_t element_count, size_t max_thread_count)
+{
+    cout << "queue,producers,consumers,payload,capacity,elements,ops_per_sec,"
+            "p50_ns,p90_ns,p99_ns,p99.9_ns,p99.99_ns,max_ns" << endl;
+    for (size_t producers = 1; producers <= max_thread_count; producers *= 2) {
+        for (size_t consumers = 1; consumers <= max_thread_count;
+                consumers *= 2) {
+            for (size_t capacity : {1024, 65536}) {
+                sweep_point<16>(producers, consumers, capacity, element_count);
+                sweep_point<64>(producers, consumers, capacity, element_count);
+                sweep_point<256>(producers, consumers, capacity, element_count);
+            }
+        }
+    }
 }
 
 string usage(char const * const program)
 {
         return string("usage: ") + program + " PRODUCERS CONSUMERS ELEMENTS "
-                "[ITERATIONS]";
+                "[ITERATIONS [RATE...]]\n"
+                "       " + program + " sweep ELEMENTS [MAX_THREADS]";
 }
 
 int main(int argc, char** argv)
 {
+    if (argc > 1 && string(argv[1]) == "sweep") {
+        long long element_count = argc > 2 ? atoll(argv[2]) : 0;
+        long long max_thread_count =
+                argc > 3 ? atoll(argv[3]) : thread::hardware_concurrency();
+        if (element_count < 1 || max_thread_count < 1) {
+            cerr << "parameters must each be > 0" << endl;
+            cerr << usage(argv[0]) << endl;
+            exit(1);
+        }
+        if (max_thread_count > element_count) {
+            cerr << "MAX_THREADS must be <= ELEMENTS" << endl;
+            cerr << usage(argv[0]) << endl;
+            exit(1);
+        }
+        sweep(static_cast<size_t>(element_count),
+                static_cast<size_t>(max_thread_count));
+        return 0;
+    }
     if (argc < 4) {
         cerr << usage(argv[0]) << endl;
         exit(1);
@@ -262,11 +681,38 @@ int main(int argc, char** argv)
         cerr << usage(argv[0]) << endl;
         exit(1);
     }
+    vector<double> rates;
+    for (int i = 5; i < argc; ++i) {
+        rates.push_back(atof(argv[i]));
+        if (rates.back() <= 0) {
+            cerr << "RATE must be > 0" << endl;
+            cerr << usage(argv[0]) << endl;
+            exit(1);
+        }
+    }
     cout << "using " << g_queue_type << endl;
-    test_concurrent_producers_consumers(
-            static_cast<size_t>(producer_count),
-            static_cast<size_t>(consumer_count),
-            static_cast<size_t>(element_count),
-            static_cast<size_t>(iterations));
+    if (rates.empty()) {
+        test_concurrent_producers_consumers(
+                static_cast<size_t>(producer_count),
+                static_cast<size_t>(consumer_count),
+                static_cast<size_t>(element_count),
+                static_cast<size_t>(iterations),
+                0);
+        return 0;
+    }
+
+    // Sweep the offered loads.
+    cout << setw(14) << "offered/s" << setw(14) << "achieved/s"
+            << setw(12) << "p50 ns" << setw(12) << "p90 ns"
+            << setw(12) << "p99 ns" << setw(12) << "p99.9 ns"
+            << setw(12) << "p99.99 ns" << setw(12) << "max ns" << endl;
+    for (auto rate : rates) {
+        test_concurrent_producers_consumers(
+                static_cast<size_t>(producer_count),
+                static_cast<size_t>(consumer_count),
+                static_cast<size_t>(element_count),
+                static_cast<size_t>(iterations),
+                rate);
+    }
     return 0;
 }
@@ -3,9 +3,11 @@
 
 #pragma once
 
+#include <memory>
 #include <queue>
 
 #include <mu/alg/heap.h>
+#include <mu/optional.h>
 
 namespace mu {
 namespace adt {
@@ -14,10 +16,16 @@ namespace adt {
 ///
 /// Time complexity is O(log(n)) for inserts and removal and constant time for
 /// access. Space complexity is as per \c std::deque.
-template <typename T>
+///
+/// \tparam Allocator The allocator of the underlying \c std::deque.
+template <typename T, typename Allocator = std::allocator<T>>
 class heap {
 public:
+    using value_type = T;
+    using allocator_type = Allocator;
+
     heap() = default;
+    explicit heap(const Allocator& a) : heap_(a) {}
     ~heap() = default;
     heap(const heap&) = default;
     heap(heap&& o) : heap_(std::move(o.heap_)) {}
@@ -33,6 +41,14 @@ public:
     /// \pre \c !empty()
     void pop() { mu::alg::heap::pop(heap_); }
 
+    /// Remove the minimum element and return it by move.
+    /// \pre \c !empty()
+    T pop_top() { return mu::alg::heap::pop_top(heap_); }
+
+    /// Remove the minimum element and return it by move, if there is one.
+    /// \return the minimum element, or an empty instance iff \c empty().
+    optional<T> try_pop();
+
     void push(const T& e) { mu::alg::heap::push(heap_, e); }
     size_t size() const { return heap_.size(); }
 
@@ -44,13 +60,25 @@ public:
     /// \return a referencethe minimum element.
     T& top() { return mu::alg::heap::top(heap_); }
 
+    allocator_type get_allocator() const { return heap_.get_allocator(); }
+
     /// \exception \c std::logic_error if any invariants don't hold.
     /// \note Recursive and not tail call optimized.
     void validate() const;
 
 private:
-    std::deque<T> heap_;
+    std::deque<T, Allocator> heap_;
 };
 
+template <typename T, typename Allocator>
+optional<T> heap<T, Allocator>::try_pop()
+{
+    using std::experimental::make_optional;
+
+    if (empty())
+        return optional<T>();
+    return make_optional<T>(pop_top());
+}
+
 } // namespace adt
 } // namespace mu
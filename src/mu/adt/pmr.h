@@ -0,0 +1,24 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+/// Aliases of the abstract data types allocating from polymorphic memory
+/// resources, apart from the types so that using them alone doesn't
+/// require \c <memory_resource> or \c <experimental/memory_resource>.
+
+#include <mu/adt/heap.h>
+#include <mu/memory_resource.h>
+
+namespace mu {
+namespace adt {
+namespace pmr {
+
+/// A \c mu::adt::heap allocating from a \c mu::pmr::memory_resource, e.g.
+/// \code mu::adt::pmr::heap<T> h(&resource); \endcode
+template <typename T>
+using heap = mu::adt::heap<T, ::mu::pmr::polymorphic_allocator<T>>;
+
+} // namespace pmr
+} // namespace adt
+} // namespace mu
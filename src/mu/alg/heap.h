@@ -3,6 +3,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace mu {
 namespace alg {
 
@@ -10,6 +18,58 @@ namespace alg {
 /// SequenceContainer with random access, e.g. \c std::deque or \c std::vector.
 namespace heap {
 
+/// The minimum number of elements for which the parallel algorithms spawn
+/// threads.  Smaller inputs are processed sequentially on the calling thread.
+constexpr static const size_t PARALLEL_MIN_SIZE = 1 << 16;
+
+/// Arrange elements into heap order.
+///
+/// Uses Floyd's bottom up construction, O(n) comparisons.
+///
+/// \param a A sequence of elements.
+/// \post \c a is in heap order.
+template <typename RandomAccess>
+void make(RandomAccess& a);
+
+/// Arrange elements into heap order using multiple threads.
+///
+/// The disjoint subtrees rooted at the first level having at least four nodes
+/// per thread are heapified concurrently, each thread taking a contiguous range
+/// of subtree roots.  The few levels above are then sifted on the calling
+/// thread.
+///
+/// \param a A sequence of elements.
+/// \param thread_count The maximum number of threads to use, including the
+///        calling thread.
+/// \post \c a is in heap order.
+/// \pre \c T's comparison operators and move operations do not throw.
+template <typename RandomAccess>
+void parallel_make(
+        RandomAccess& a,
+        size_t thread_count = std::thread::hardware_concurrency());
+
+/// Select the minimum elements of a sequence using multiple threads.
+///
+/// The sequence is split into one chunk per thread.  Each thread heapifies its
+/// chunk and pops its \c n minimum elements to the back of the chunk.  The
+/// sorted chunk tails are then merged on the calling thread using a heap of
+/// chunk cursors.  Time complexity is O(a.size() / thread_count + n log(a.size()))
+/// per thread versus O(a.size() log(n)) for \c std::partial_sort.
+///
+/// \param a A sequence of elements.
+/// \param n The number of elements to select.
+/// \param thread_count The maximum number of threads to use, including the
+///        calling thread.
+/// \return copies of the \c min(n, a.size()) minimum elements of \c a in
+///         ascending order.
+/// \post \c a is a permutation of its prior value.
+/// \pre \c T's comparison operators and move operations do not throw.
+template <typename RandomAccess>
+std::vector<typename RandomAccess::value_type> top_n(
+        RandomAccess& a,
+        size_t n,
+        size_t thread_count = std::thread::hardware_concurrency());
+
 /// Insert an element into a heap.
 ///
 /// \param a A sequence elements in heap order.
@@ -25,11 +85,25 @@ void emplace(RandomAccess& a, typename RandomAccess::value_type&& e);
 
 /// Remove the minimum element from a heap.
 ///
+/// The last element is moved into a temporary and the vacated root, the
+/// "hole", is moved down the heap by shifting the lesser child up into it at
+/// each level, until the temporary can be moved into the hole.  Each level
+/// costs one move rather than the three of a swap.
+///
 /// \param a A sequence of elements in heap order.
 /// \post \c does not contain \c e and is in heap order.
 template <typename RandomAccess>
 void pop(RandomAccess& a);
 
+/// Remove the minimum element from a heap and return it by move.
+///
+/// \param a A non empty sequence of elements in heap order.
+/// \return the former minimum element.
+/// \post \c a is in heap order.
+/// \see \c pop
+template <typename RandomAccess>
+typename RandomAccess::value_type pop_top(RandomAccess& a);
+
 /// \param a A non empty array of elements in heap order.
 /// \return a reference to the minimum element.
 template <typename RandomAccess>
@@ -37,16 +111,22 @@ typename RandomAccess::value_type& top(RandomAccess& a);
 
 /// Bubble up the last element.
 ///
+/// The element is carried in a temporary whilst parents are shifted down into
+/// the vacated position, one move per level rather than a three move swap.
+///
 /// \param a An array of elements in heap order, with the possible exception of
 /// the last one.
 /// \post \c a is in heap order.
 template <typename RandomAccess>
 void bubble_last(RandomAccess& a);
 
-/// Bubble up the last element.
+/// Sift down the first element.
+///
+/// The element is carried in a temporary whilst the lesser child is shifted up
+/// into the vacated position, one move per level rather than a three move swap.
 ///
 /// \param a An array of elements in heap order, with the possible exception of
-/// the last one.
+/// the first one.
 /// \post \c a is in heap order.
 template <typename RandomAccess>
 void sift_first(RandomAccess& a);
@@ -64,11 +144,119 @@ bool validate(const RandomAccess& a);
 namespace impl {
 
 // Don't handle overflow, vector::push_back will raise an exception first.
-size_t left_child_index(const size_t i) { return (2 * i) + 1; }
-size_t parent_index(const size_t i) { return (i - 1) / 2; }
+inline size_t left_child_index(const size_t i) { return (2 * i) + 1; }
+inline size_t parent_index(const size_t i) { return (i - 1) / 2; }
 
 // Don't handle overflow, vector::push_back will raise an exception first.
-size_t right_child_index(const size_t i) { return (2 * i) + 2; }
+inline size_t right_child_index(const size_t i) { return (2 * i) + 2; }
+
+// Return the index of the lesser child of i in the heap of n elements starting
+// at first, or n if i is a leaf.
+template <typename RandomIt>
+size_t min_child_index(RandomIt first, const size_t i, const size_t n)
+{
+    const size_t l = left_child_index(i);
+    const size_t r = right_child_index(i);
+    if (l >= n) {
+        return n;
+    }
+    return r < n && first[r] < first[l] ? r : l;
+}
+
+// Move the hole at index i down the heap of n elements starting at first by
+// shifting the lesser child up into it, until e can be moved into the hole
+// without breaking heap order.
+template <typename RandomIt, typename T>
+void sift_hole(RandomIt first, size_t i, const size_t n, T&& e)
+{
+    for (size_t c = min_child_index(first, i, n);
+            c < n && first[c] < e;
+            c = min_child_index(first, i, n)) {
+        first[i] = std::move(first[c]);
+        i = c;
+    }
+    first[i] = std::move(e);
+}
+
+// Sift the element at index i down the heap of n elements starting at first.
+template <typename RandomIt>
+void sift_down(RandomIt first, const size_t i, const size_t n)
+{
+    // Leave an element that is already in order in place, otherwise carry it
+    // in a temporary whilst the hole moves down.
+    const size_t c = min_child_index(first, i, n);
+    if (c >= n || !(first[c] < first[i])) {
+        return;
+    }
+    auto e = std::move(first[i]);
+    first[i] = std::move(first[c]);
+    sift_hole(first, c, n, std::move(e));
+}
+
+// Floyd's construction over the n elements starting at first.
+template <typename RandomIt>
+void make(RandomIt first, const size_t n)
+{
+    // Elements at n / 2 and above are leaves.
+    for (size_t i = n / 2; i > 0; --i) {
+        sift_down(first, i - 1, n);
+    }
+}
+
+// Heapify the subtrees rooted at [lo, hi), a range of indices within one level
+// of the heap of n elements starting at first.  Subtree descendants occupy one
+// contiguous range per level, [left_child_index(lo), left_child_index(hi)) at
+// the level below and so on, so the subtrees are disjoint from those of any
+// other range in the same level.
+template <typename RandomIt>
+void make_subtrees(RandomIt first, const size_t n, size_t lo, size_t hi)
+{
+    // Collect the internal node ranges, top down, then sift bottom up.
+    std::vector<std::pair<size_t, size_t>> levels;
+    for (; lo < n / 2; lo = left_child_index(lo), hi = left_child_index(hi)) {
+        levels.emplace_back(lo, std::min(hi, n / 2));
+    }
+    for (auto l = levels.rbegin(); l != levels.rend(); ++l) {
+        for (size_t i = l->second; i > l->first; --i) {
+            sift_down(first, i - 1, n);
+        }
+    }
+}
+
+// Split [0, n) into count contiguous ranges and invoke f(i, begin, end) for
+// each range i, concurrently, with the first range on the calling thread.
+// Ranges for which no thread could be started are invoked inline.
+template <typename F>
+void parallel_for_ranges(const size_t n, const size_t count, const F& f)
+{
+    const size_t size = n / count;
+    const size_t remainder = n % count;
+    auto begin = [=](size_t i) { return i * size + std::min(i, remainder); };
+
+    std::vector<std::thread> threads;
+    threads.reserve(count - 1);
+    for (size_t i = 1; i < count; ++i) {
+        try {
+            threads.emplace_back(f, i, begin(i), begin(i + 1));
+        } catch (const std::system_error&) {
+            f(i, begin(i), begin(i + 1));
+        }
+    }
+    f(0, begin(0), begin(1));
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// A position within one of top_n's sorted chunk tails.  The tail is in
+// descending order so the cursor moves towards the chunk's beginning.
+template <typename RandomIt>
+struct cursor {
+    RandomIt position_;
+    size_t remaining_;
+
+    bool operator<(const cursor& o) const { return *position_ < *o.position_; }
+};
 
 // Recursive and not a tail-call.
 template <typename RandomAccess>
@@ -117,21 +305,135 @@ void push(RandomAccess& a, typename RandomAccess::value_type&& e)
     bubble_last(a);
 }
 
+template <typename RandomAccess>
+void make(RandomAccess& a)
+{
+    impl::make(a.begin(), a.size());
+}
+
+template <typename RandomAccess>
+void parallel_make(RandomAccess& a, size_t thread_count)
+{
+    using namespace impl;
+
+    const size_t n = a.size();
+    if (thread_count < 2 || n < PARALLEL_MIN_SIZE) {
+        make(a);
+        return;
+    }
+
+    // Find the first level with enough subtrees to balance the load, allowing
+    // for the last level of the heap being only partially filled.
+    size_t lo = 0;
+    size_t hi = 1;
+    while (hi - lo < 4 * thread_count && left_child_index(lo) < n / 2) {
+        lo = left_child_index(lo);
+        hi = left_child_index(hi);
+    }
+
+    auto first = a.begin();
+    parallel_for_ranges(
+            hi - lo,
+            std::min(thread_count, hi - lo),
+            [=](size_t, size_t b, size_t e) {
+                make_subtrees(first, n, lo + b, lo + e);
+            });
+
+    // Sift the levels above those of the subtree roots.
+    for (size_t i = lo; i > 0; --i) {
+        sift_down(first, i - 1, n);
+    }
+}
+
+template <typename RandomAccess>
+std::vector<typename RandomAccess::value_type> top_n(
+        RandomAccess& a,
+        size_t n,
+        size_t thread_count)
+{
+    using namespace impl;
+    using value_type = typename RandomAccess::value_type;
+
+    const size_t size = a.size();
+    n = std::min(n, size);
+    std::vector<value_type> out;
+    if (n == 0) {
+        return out;
+    }
+    if (thread_count < 1 || size < PARALLEL_MIN_SIZE) {
+        thread_count = 1;
+    }
+    thread_count = std::min(thread_count, size);
+
+    // Pop each chunk's minimum elements to the back of the chunk, leaving
+    // them in descending order.
+    using iterator = decltype(a.begin());
+    auto first = a.begin();
+    std::vector<cursor<iterator>> cursors(thread_count);
+    parallel_for_ranges(
+            size,
+            thread_count,
+            [=, &cursors](size_t t, size_t b, size_t e) {
+                auto chunk = first + b;
+                size_t heap_size = e - b;
+                const size_t count = std::min(n, heap_size);
+                impl::make(chunk, heap_size);
+                for (size_t i = 0; i < count; ++i) {
+                    --heap_size;
+                    auto last = std::move(chunk[heap_size]);
+                    chunk[heap_size] = std::move(chunk[0]);
+                    sift_hole(chunk, 0, heap_size, std::move(last));
+                }
+                cursors[t] = cursor<iterator>{chunk + (e - b - 1), count};
+            });
+
+    // Merge the chunk tails.
+    cursors.erase(
+            std::remove_if(
+                    cursors.begin(),
+                    cursors.end(),
+                    [](const cursor<iterator>& c) { return c.remaining_ == 0; }),
+            cursors.end());
+    make(cursors);
+    out.reserve(n);
+    while (out.size() < n) {
+        auto& c = top(cursors);
+        out.push_back(*c.position_);
+        if (--c.remaining_ == 0) {
+            pop(cursors);
+        } else {
+            --c.position_;
+            sift_first(cursors);
+        }
+    }
+    return out;
+}
+
 template <typename RandomAccess>
 void pop(RandomAccess& a)
 {
     assert(!a.empty());
 
     if (a.size() == 1) {
-        a.pop_front();
+        a.pop_back();
         return;
     }
 
-    // Replace the first element with the last, breaking ordering, but
-    // preserving the shape property. Sift to restore ordering.
-    std::swap(a[0], a[a.size() - 1]);
+    // Take the last element, preserving the shape property, and find its place
+    // by moving the root's hole down.
+    auto e = std::move(a.back());
     a.pop_back();
-    sift_first(a);
+    impl::sift_hole(a.begin(), 0, a.size(), std::move(e));
+}
+
+template <typename RandomAccess>
+typename RandomAccess::value_type pop_top(RandomAccess& a)
+{
+    assert(!a.empty());
+
+    auto e = std::move(a[0]);
+    pop(a);
+    return e;
 }
 
 template <typename RandomAccess>
@@ -148,57 +450,24 @@ void bubble_last(RandomAccess& a)
         return;
     }
     size_t p = parent_index(i);
-    while (i > 0 && a[i] < a[p]) {
-        std::swap(a[i], a[p]);
+    if (!(a[i] < a[p])) {
+        return;
+    }
+
+    // Move parents down into the hole until the element's place is found.
+    auto e = std::move(a[i]);
+    do {
+        a[i] = std::move(a[p]);
         i = p;
         p = parent_index(i);
-    }
+    } while (i > 0 && e < a[p]);
+    a[i] = std::move(e);
 }
 
 template <typename RandomAccess>
 void sift_first(RandomAccess& a)
 {
-    using namespace impl;
-    using namespace std;
-
-    if (a.empty()) {
-        return;
-    }
-
-    size_t i = 0;
-    while (true) {
-        auto& element = a[i];
-        const size_t l = left_child_index(i);
-        const size_t r = right_child_index(i);
-
-        // Base cases.
-        if (l >= a.size()) {
-            // The end of the heap has been reached.
-            break;
-        }
-        auto& leftchild = a[l];
-        if (r >= a.size()) {
-            // The left child is the last element in the heap.
-            if (leftchild < element) {
-                swap(leftchild, element);
-            }
-            break;
-        }
-        auto& rightchild = a[r];
-        if (element < leftchild && element < rightchild) {
-            // The heap invariant holds again.
-            break;
-        }
-
-        // Iterate. Sift left or right depending on child priority.
-        if (leftchild < rightchild) {
-            swap(leftchild, element);
-            i = l;
-        } else {
-            swap(rightchild, element);
-            i = r;
-        }
-    }
+    impl::sift_down(a.begin(), 0, a.size());
 }
 
 template <typename RandomAccess>
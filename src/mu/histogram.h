@@ -0,0 +1,222 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace mu {
+
+/// A log-linear histogram of unsigned 64-bit values, e.g. latencies in
+/// nanoseconds, in the manner of HdrHistogram.
+///
+/// Values below \c 2^sub_bucket_bits are counted exactly.  Above that each
+/// power of two range is divided into \c 2^(sub_bucket_bits-1) equal buckets so
+/// the relative error of any reported value is below \c 2^-(sub_bucket_bits-1).
+/// The whole 64-bit range is covered without configuring a maximum.
+///
+/// Recording is lock-free, using relaxed atomic operations, so may be performed
+/// concurrently, though recording into a histogram per thread and merging
+/// afterwards avoids contention on the counts.  Queries are only consistent
+/// once recording has stopped.
+class histogram {
+public:
+    constexpr static const unsigned DEFAULT_SUB_BUCKET_BITS = 8;
+    constexpr static const unsigned MIN_SUB_BUCKET_BITS = 1;
+    constexpr static const unsigned MAX_SUB_BUCKET_BITS = 16;
+
+    /// \param sub_bucket_bits The precision, in
+    ///        [\c MIN_SUB_BUCKET_BITS, \c MAX_SUB_BUCKET_BITS].
+    explicit histogram(unsigned sub_bucket_bits = DEFAULT_SUB_BUCKET_BITS);
+    histogram(const histogram&) = delete;
+    histogram& operator=(const histogram&) = delete;
+
+    /// Record \c count occurrences of \c value.
+    void record(uint64_t value, uint64_t count = 1);
+
+    /// Add the counts of \c o, which must have the same precision.
+    void merge(const histogram& o);
+
+    /// Discard all recorded values.
+    void reset();
+
+    /// \return the number of values recorded.
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    /// \return the least value recorded, or zero if none have been.
+    uint64_t min() const;
+
+    /// \return the greatest value recorded, or zero if none have been.
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    /// \return the mean of the values recorded, or zero if none have been.
+    double mean() const;
+
+    /// \return the value at or below which \c percentile percent of the
+    ///         recorded values lie, to the histogram's precision, or zero if
+    ///         none have been recorded.
+    uint64_t percentile(double percentile) const;
+
+    unsigned sub_bucket_bits() const { return sub_bucket_bits_; }
+
+private:
+    /// \return the index of the bucket counting \c value.
+    size_t index(uint64_t value) const;
+
+    /// \return the greatest value counted by bucket \c i.
+    uint64_t highest_equivalent(size_t i) const;
+
+    static void update_min(std::atomic<uint64_t>& m, uint64_t value);
+    static void update_max(std::atomic<uint64_t>& m, uint64_t value);
+
+    const unsigned sub_bucket_bits_;
+    const size_t bucket_count_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+inline histogram::histogram(const unsigned sub_bucket_bits) :
+        sub_bucket_bits_(sub_bucket_bits),
+        // Exact buckets for [0, 2^b) then 2^(b-1) per power of two above.
+        bucket_count_((66 - sub_bucket_bits) << (sub_bucket_bits - 1)),
+        counts_(new std::atomic<uint64_t>[bucket_count_]),
+        count_(0),
+        sum_(0),
+        min_(std::numeric_limits<uint64_t>::max()),
+        max_(0)
+{
+    assert(sub_bucket_bits >= MIN_SUB_BUCKET_BITS);
+    assert(sub_bucket_bits <= MAX_SUB_BUCKET_BITS);
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+inline void histogram::record(const uint64_t value, const uint64_t count)
+{
+    counts_[index(value)].fetch_add(count, std::memory_order_relaxed);
+    count_.fetch_add(count, std::memory_order_relaxed);
+    sum_.fetch_add(value * count, std::memory_order_relaxed);
+    update_min(min_, value);
+    update_max(max_, value);
+}
+
+inline void histogram::merge(const histogram& o)
+{
+    assert(o.sub_bucket_bits_ == sub_bucket_bits_);
+    if (o.count() == 0)
+        return;
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        const uint64_t n = o.counts_[i].load(std::memory_order_relaxed);
+        if (n > 0)
+            counts_[i].fetch_add(n, std::memory_order_relaxed);
+    }
+    count_.fetch_add(o.count(), std::memory_order_relaxed);
+    sum_.fetch_add(o.sum_.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    update_min(min_, o.min());
+    update_max(max_, o.max());
+}
+
+inline void histogram::reset()
+{
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+inline uint64_t histogram::min() const
+{
+    return count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+}
+
+inline double histogram::mean() const
+{
+    const uint64_t n = count();
+    return n == 0 ? 0 :
+            static_cast<double>(sum_.load(std::memory_order_relaxed)) / n;
+}
+
+inline uint64_t histogram::percentile(const double percentile) const
+{
+    const uint64_t n = count();
+    if (n == 0)
+        return 0;
+
+    // The rank of the value sought, from 1.
+    const double p = std::min(std::max(percentile, 0.0), 100.0);
+    const uint64_t rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(p / 100 * n + 0.5));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(highest_equivalent(i), max());
+    }
+    return max();
+}
+
+inline size_t histogram::index(const uint64_t value) const
+{
+    const uint64_t exact = uint64_t(1) << sub_bucket_bits_;
+    if (value < exact)
+        return static_cast<size_t>(value);
+
+    // Shift the value into [2^(b-1), 2^b), offsetting by the buckets of the
+    // power of two ranges below.
+    const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    const unsigned shift = msb - sub_bucket_bits_ + 1;
+    return (static_cast<size_t>(shift) << (sub_bucket_bits_ - 1)) +
+            static_cast<size_t>(value >> shift);
+}
+
+inline uint64_t histogram::highest_equivalent(const size_t i) const
+{
+    const size_t exact = size_t(1) << sub_bucket_bits_;
+    if (i < exact)
+        return i;
+
+    const size_t half = exact / 2;
+    const unsigned shift = static_cast<unsigned>(i / half - 1);
+    const uint64_t sub_bucket = i - shift * half;
+    const uint64_t lowest = sub_bucket << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+inline void histogram::update_min(
+        std::atomic<uint64_t>& m,
+        const uint64_t value)
+{
+    uint64_t current = m.load(std::memory_order_relaxed);
+    while (value < current &&
+            !m.compare_exchange_weak(
+                    current, value, std::memory_order_relaxed)) {
+    }
+}
+
+inline void histogram::update_max(
+        std::atomic<uint64_t>& m,
+        const uint64_t value)
+{
+    uint64_t current = m.load(std::memory_order_relaxed);
+    while (value > current &&
+            !m.compare_exchange_weak(
+                    current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace mu
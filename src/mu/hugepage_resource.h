@@ -0,0 +1,212 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <mu/memory_resource.h>
+
+namespace mu {
+
+/// The kind of pages backing memory.
+enum class page_backing {
+    hugetlb,        ///< Explicit huge pages, \c mmap(MAP_HUGETLB).
+    transparent,    ///< Transparent huge pages, \c madvise(MADV_HUGEPAGE).
+    normal          ///< Base pages.
+};
+
+/// A monotonic memory resource allocating from 2 MB aligned chunks backed by
+/// huge pages, reducing TLB misses when walking many small nodes, e.g. those of
+/// \c mu::lf::pmr::queue.
+///
+/// Chunks are mapped with \c MAP_HUGETLB if preferred and huge pages are
+/// reserved, otherwise they are advised as \c MADV_HUGEPAGE if preferred and
+/// supported, otherwise they are backed by base pages.
+///
+/// Allocation is lock-free unless a new chunk is required.  Deallocation is a
+/// no-op, memory is released on destruction, so the resource suits containers
+/// that pool their nodes.  Safe for concurrent use.
+class hugepage_resource : public pmr::memory_resource {
+public:
+    constexpr static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    constexpr static const size_t DEFAULT_CHUNK_SIZE = 16 * HUGE_PAGE_SIZE;
+
+    /// \param preferred The preferred backing, falling back as described.
+    /// \param chunk_size The minimum size of each mapping, rounded up to a
+    ///        multiple of \c HUGE_PAGE_SIZE.
+    explicit hugepage_resource(
+            page_backing preferred = page_backing::hugetlb,
+            size_t chunk_size = DEFAULT_CHUNK_SIZE);
+    hugepage_resource(const hugepage_resource&) = delete;
+    hugepage_resource& operator=(const hugepage_resource&) = delete;
+    ~hugepage_resource();
+
+    /// \return the least preferred backing of any chunk mapped so far, or the
+    ///         preferred backing if none have been.
+    page_backing backing() const { return backing_; }
+
+    /// \return the total size of the mapped chunks.
+    size_t mapped() const;
+
+private:
+    struct chunk {
+        char* begin_;
+        size_t size_;
+        std::atomic<size_t> used_;
+    };
+
+    static size_t round_up(size_t n, size_t m) { return (n + m - 1) / m * m; }
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const pmr::memory_resource& o) const noexcept override
+    {
+        return this == &o;
+    }
+
+    /// Bump allocate from \c c, returning \c nullptr if it's exhausted.
+    static void* allocate_from(chunk* c, size_t bytes, size_t alignment);
+
+    /// Map a new chunk of at least \c size bytes, updating \c backing_.
+    chunk* map(size_t size);
+
+    const page_backing preferred_;
+    const size_t chunk_size_;
+    std::atomic<page_backing> backing_;
+    std::atomic<chunk*> current_;
+    mutable std::mutex mutex_;          /// Guards chunks_ and mapping.
+    std::vector<chunk*> chunks_;
+};
+
+inline hugepage_resource::hugepage_resource(
+        const page_backing preferred,
+        const size_t chunk_size) :
+        preferred_(preferred),
+        chunk_size_(round_up(chunk_size, HUGE_PAGE_SIZE)),
+        backing_(preferred),
+        current_(nullptr)
+{
+}
+
+inline hugepage_resource::~hugepage_resource()
+{
+    for (auto c : chunks_) {
+        munmap(c->begin_, c->size_);
+        delete c;
+    }
+}
+
+inline size_t hugepage_resource::mapped() const
+{
+    std::lock_guard<std::mutex> _(mutex_);
+    size_t size = 0;
+    for (auto c : chunks_) {
+        size += c->size_;
+    }
+    return size;
+}
+
+inline void* hugepage_resource::allocate_from(
+        chunk* const c,
+        const size_t bytes,
+        const size_t alignment)
+{
+    if (c == nullptr)
+        return nullptr;
+
+    size_t used = c->used_.load();
+    while (true) {
+        const auto base = reinterpret_cast<uintptr_t>(c->begin_);
+        const size_t offset = round_up(base + used, alignment) - base;
+        if (offset + bytes > c->size_)
+            return nullptr;
+        if (c->used_.compare_exchange_weak(used, offset + bytes))
+            return c->begin_ + offset;
+    }
+}
+
+inline void* hugepage_resource::do_allocate(
+        const size_t bytes,
+        const size_t alignment)
+{
+    while (true) {
+        chunk* c = current_.load();
+        void* p = allocate_from(c, bytes, alignment);
+        if (p != nullptr)
+            return p;
+
+        // Replace the exhausted chunk unless another thread already has.
+        std::lock_guard<std::mutex> _(mutex_);
+        if (current_.load() == c)
+            current_.store(map(bytes + alignment));
+    }
+}
+
+inline hugepage_resource::chunk* hugepage_resource::map(size_t size)
+{
+    size = round_up(std::max(size, chunk_size_), HUGE_PAGE_SIZE);
+
+    // Make room to record the chunk before mapping it, so that recording it
+    // can't throw.
+    chunks_.reserve(chunks_.size() + 1);
+
+    const int protection = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void* p = MAP_FAILED;
+    page_backing backing = page_backing::normal;
+
+#if defined(MAP_HUGETLB)
+    if (preferred_ == page_backing::hugetlb) {
+        p = mmap(nullptr, size, protection, flags | MAP_HUGETLB, -1, 0);
+        backing = page_backing::hugetlb;
+    }
+#endif
+
+    if (p == MAP_FAILED) {
+        // Over map to trim to a huge page aligned region, allowing the kernel
+        // to back it with transparent huge pages.
+        char* q = static_cast<char*>(
+                mmap(nullptr, size + HUGE_PAGE_SIZE, protection, flags, -1, 0));
+        if (q == MAP_FAILED)
+            throw std::bad_alloc();
+        const size_t head =
+                round_up(reinterpret_cast<uintptr_t>(q), HUGE_PAGE_SIZE) -
+                reinterpret_cast<uintptr_t>(q);
+        if (head > 0)
+            munmap(q, head);
+        munmap(q + head + size, HUGE_PAGE_SIZE - head);
+        p = q + head;
+
+        backing = page_backing::normal;
+#if defined(MADV_HUGEPAGE)
+        if (preferred_ != page_backing::normal &&
+                madvise(p, size, MADV_HUGEPAGE) == 0) {
+            backing = page_backing::transparent;
+        }
+#endif
+    }
+
+    chunk* c;
+    try {
+        c = new chunk{static_cast<char*>(p), size, {0}};
+    } catch (...) {
+        munmap(p, size);
+        throw;
+    }
+    chunks_.push_back(c);
+
+    if (backing > backing_.load())
+        backing_.store(backing);
+    return c;
+}
+
+} // namespace mu
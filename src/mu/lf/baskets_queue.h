@@ -0,0 +1,474 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+#include <mu/lf/impl/node_value.h>
+#include <mu/lf/links.h>
+#include <mu/lf/provision.h>
+#include <mu/lf/stack.h>
+#include <mu/lf/stats.h>
+#include <mu/optional.h>
+
+namespace mu {
+namespace lf {
+
+/// A lock-free, multi-producer multi-consumer, unbounded queue that reduces
+/// enqueue contention by gathering concurrent enqueues into baskets.
+///
+/// Enqueuers that lose the race to link their node after the tail don't retry
+/// from the new tail, as those of \c mu::lf::queue do, where most fail again
+/// under contention.  Having overlapped in time, their enqueues may be ordered
+/// arbitrarily, so each inserts its node into the winner's basket, after the
+/// old tail, needing only that link to be unchanged.  Dequeuers mark nodes
+/// deleted rather than swinging the head each time, advancing it lazily over
+/// several deleted nodes at once.
+///
+/// Shares the interface, capacity provisioning and exception guarantees of
+/// \c mu::lf::queue.  The order of elements enqueued concurrently is
+/// unspecified, but each producer's elements are dequeued in the order
+/// enqueued.
+///
+/// \tparam T must be default constructable, assignable and copy constructable.
+/// \tparam Allocator Rebound to allocate the queue's nodes and those of its
+///         free list.  Must be safe for concurrent use and have raw pointers.
+///
+/// \internal The implementation is based on "The Baskets Queue" by Hoffman,
+///           Shalev and Shavit.  A sentinel head node is used.  Each link's
+///           tag holds a deleted mark in its least significant bit and above
+///           it a counter, identifying the basket of links set while the tail
+///           had a given counter.
+template <typename T, typename Allocator = std::allocator<T>>
+class baskets_queue {
+private:
+    struct node;
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+
+    constexpr static const size_t DEFAULT_INITIAL_CAPACITY = 8192;
+
+    /// Construct with the specified initial capacity.
+    ///
+    /// \param initial_capacity the initial capacity in number of nodes.
+    /// \param a the allocator from which nodes are allocated.
+    baskets_queue(size_t initial_capacity, const Allocator& a = Allocator());
+
+    /// Construct with the specified initial capacity, provisioned as \c p
+    /// specifies.
+    baskets_queue(
+            size_t initial_capacity,
+            provision p,
+            const Allocator& a = Allocator());
+
+    /// Construct with the default initial capacity.
+    baskets_queue();
+
+    /// Construct with the default initial capacity.
+    explicit baskets_queue(const Allocator& a);
+
+    baskets_queue(const baskets_queue&) = delete;
+
+    /// \pre \c empty() is \c true
+    ~baskets_queue();
+    baskets_queue& operator=(const baskets_queue&) = delete;
+
+    /// Remove the head of the queue.
+    ///
+    /// \return \c true iff a valid, T value was assigned to \c out.
+    bool pop(T& out);
+
+    /// Remove the head of the queue.
+    ///
+    /// \return a valid, T value, or \c false.
+    optional<T> pop();
+
+    /// Move a value onto the queue.
+    void emplace(T&& e);
+
+    /// Copy a value onto the queue.
+    void push(const T& e);
+
+    /// \return \c true iff the queue has no nodes available for dequeueing.
+    bool empty() const;
+
+    size_t capacity() const { return capacity_; }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(pool_.get_allocator());
+    }
+
+private:
+    /// Deleted nodes traversed by a dequeue before it advances the head.
+    constexpr static const size_t MAX_HOPS = 3;
+
+    using link = pointer_links::link<node>;
+    using link_value = typename link::value;
+
+    struct alignas(impl::node_alignment<
+            pointer_links, link, impl::node_value<T>>()) node {
+        node() : next_(nullptr) {}
+        impl::node_value<T> value_;
+        link next_;
+    };
+
+    using traits = std::allocator_traits<Allocator>;
+    using node_allocator = typename traits::template rebind_alloc<node>;
+    using free_list = stack<
+            link_value,
+            typename traits::template rebind_alloc<link_value>,
+            pointer_links>;
+
+    /// \return the basket counter of \c v's tag.
+    static size_t basket(link_value v) { return v.get_tag() >> 1; }
+
+    /// \return the basket counter following \c b, wrapping.
+    static size_t next_basket(size_t b)
+    {
+        return (b + 1) & (link_value::max_tag() >> 1);
+    }
+
+    /// \return \c true iff \c v links a dequeued node.
+    static bool deleted(link_value v) { return (v.get_tag() & 1) != 0; }
+
+    /// \return \c v with the basket counter \c b and deleted mark \c d.
+    static link_value mark(link_value v, size_t b, bool d)
+    {
+        return v.with_tag(b << 1 | (d ? 1 : 0));
+    }
+
+    static bool same_node(link_value a, link_value b)
+    {
+        return static_cast<node*>(a) == static_cast<node*>(b);
+    }
+
+    void destroy() noexcept;            /// Free all instance resources.
+    void provide(size_t);               /// Allocate nodes onto the free list.
+    link_value alloc_node();            /// Return a free or new node.
+    void free_node(link_value);         /// Release to pool of free nodes.
+    bool dequeue(T&);
+    void enqueue(link_value) noexcept;
+
+    /// \return the last node reachable from \c n while \c tail_ is \c tail.
+    link_value last(link_value tail, link_value n) const;
+
+    /// Move \c tail_ from \c tail to \c last, if still the last node.
+    void fix_tail(link_value tail, link_value last);
+
+    /// Move \c head_ from \c head to \c new_head, freeing the nodes between.
+    void free_chain(link_value head, link_value new_head);
+
+    impl::node_pool<node, node_allocator, pointer_links> pool_;
+    std::atomic<size_t> capacity_;  /// Total capacity, free + used nodes.
+    std::atomic<size_t> reserve_;   /// Capacity yet to be provisioned.
+    link head_;                     /// Sentinel, followed by deleted nodes.
+    link tail_;                     /// Tail, or behind it.
+    free_list free_;                /// Free node list.
+};
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::destroy() noexcept
+{
+    link_value n;
+    while (free_.pop(n)) {
+        pool_.destroy(n);
+    }
+
+    // The sentinel and any deleted nodes the head is yet to advance over.
+    for (link_value i = head_.load(); i; i = n) {
+        n = i->next_.load();
+        pool_.destroy(i);
+    }
+}
+
+template <typename T, typename Allocator>
+baskets_queue<T, Allocator>::baskets_queue(
+        size_t const initial_capacity,
+        const Allocator& a) :
+        baskets_queue(initial_capacity, provision::eager, a)
+{
+}
+
+template <typename T, typename Allocator>
+baskets_queue<T, Allocator>::baskets_queue(
+        size_t const initial_capacity,
+        provision const p,
+        const Allocator& a) :
+        pool_(node_allocator(a)),
+        capacity_(initial_capacity),
+        reserve_(0),
+        head_(),
+        tail_(),
+        free_(free_list::DEFAULT_INITIAL_CAPACITY,
+                p == provision::lazy ? provision::lazy : provision::eager,
+                a)
+{
+    try {
+        impl::provision_nodes(p, initial_capacity, reserve_,
+                [this](size_t count) { provide(count); });
+        link_value n(alloc_node());
+        n->next_ = nullptr;
+        head_ = n;
+        tail_ = n;
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+template <typename T, typename Allocator>
+baskets_queue<T, Allocator>::baskets_queue() :
+        baskets_queue(DEFAULT_INITIAL_CAPACITY)
+{
+}
+
+template <typename T, typename Allocator>
+baskets_queue<T, Allocator>::baskets_queue(const Allocator& a) :
+        baskets_queue(DEFAULT_INITIAL_CAPACITY, a)
+{
+}
+
+template <typename T, typename Allocator>
+baskets_queue<T, Allocator>::~baskets_queue()
+{
+    assert(empty());
+    destroy();
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::provide(size_t const count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        link_value n(pool_.create());
+        try {
+            free_.push(n);
+        } catch (...) {
+            pool_.destroy(n);
+            throw;
+        }
+    }
+}
+
+template <typename T, typename Allocator>
+typename baskets_queue<T, Allocator>::link_value
+baskets_queue<T, Allocator>::alloc_node()
+{
+    link_value n;
+    while (!free_.pop(n)) {
+        // Provision a batch of any reserved capacity, else grow.
+        const size_t reserved = impl::claim(reserve_, impl::LAZY_BATCH);
+        if (reserved == 0) {
+            n = pool_.create();
+            ++capacity_;
+            break;
+        }
+        provide(reserved);
+    }
+    return n;
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::free_node(link_value e)
+{
+    free_.push(e);
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::push(T const & value)
+{
+    link_value n = alloc_node();
+    n->value_.store(value, [&] { free_node(n); });
+    enqueue(n);
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::emplace(T&& value)
+{
+    link_value n = alloc_node();
+    n->value_.store(std::move(value), [&] { free_node(n); });
+    enqueue(n);
+}
+
+template <typename T, typename Allocator>
+typename baskets_queue<T, Allocator>::link_value
+baskets_queue<T, Allocator>::last(link_value const tail, link_value n) const
+{
+    for (link_value next = n->next_.load(); next && tail_.load() == tail;
+            next = n->next_.load()) {
+        n = next;
+    }
+    return n;
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::fix_tail(
+        link_value const tail,
+        link_value const last)
+{
+    if (!last->next_.load() && tail_.load() == tail)
+        tail_.compare_set_strong(tail,
+                mark(last, next_basket(basket(tail)), false));
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::free_chain(
+        link_value head,
+        link_value const new_head)
+{
+    if (!head_.compare_set_strong(head,
+            mark(new_head, next_basket(basket(head)), false)))
+        return;
+
+    while (!same_node(head, new_head)) {
+        const link_value next = head->next_.load();
+        free_node(head);
+        head = next;
+    }
+}
+
+template <typename T, typename Allocator>
+void baskets_queue<T, Allocator>::enqueue(link_value const n) noexcept
+{
+    while (true) {
+        const link_value tail = tail_.load();
+        link_value next = tail->next_.load();
+
+        // Verify read of tail_ and tail_->next_ is consistent.
+        if (tail != tail_.load()) {
+            impl::count_retry();
+            continue;
+        }
+
+        if (next) {
+            // The tail pointer has fallen behind, attempt to move it along.
+            fix_tail(tail, last(tail, next));
+            impl::count_retry();
+            continue;
+        }
+
+        // Attempt to link in the new node, opening a basket.
+        const size_t b = next_basket(basket(tail));
+        n->next_ = mark(link_value(), next_basket(b), false);
+        if (tail->next_.compare_set_strong(next, mark(n, b, false))) {
+            // If this update fails, another operation will update the tail.
+            tail_.compare_set_strong(tail, mark(n, b, false));
+            return;
+        }
+        impl::count_retry();
+
+        // Having lost to a concurrent enqueue, join its basket while open,
+        // i.e. until the tail moves on or a node of the basket is dequeued.
+        next = tail->next_.load();
+        while (basket(next) == b && !deleted(next)) {
+            n->next_ = next;
+            if (tail->next_.compare_set_strong(next, mark(n, b, false)))
+                return;
+            impl::count_retry();
+            next = tail->next_.load();
+        }
+    }
+}
+
+template <typename T, typename Allocator>
+bool baskets_queue<T, Allocator>::pop(T& out) { return dequeue(out); }
+
+template <typename T, typename Allocator>
+optional<T> baskets_queue<T, Allocator>::pop()
+{
+    using std::experimental::make_optional;
+    using std::move;
+
+    T value;
+    if (dequeue(value))
+        return make_optional<T>(move(value));
+    return optional<T>();
+}
+
+template <typename T, typename Allocator>
+bool baskets_queue<T, Allocator>::dequeue(T& value)
+{
+    while (true) {
+        // Read the state in an order allowing consistency verification.
+        const link_value head = head_.load();
+        const link_value tail = tail_.load();
+        link_value next = head->next_.load();
+
+        // Verify read of head_, tail_ and head_->next_ is consistent.
+        if (head != head_.load()) {
+            impl::count_retry();
+            continue;
+        }
+
+        if (same_node(head, tail)) {
+            if (!next) {
+                // The queue is empty.
+                return false;
+            }
+            // The tail pointer has fallen behind, attempt to move it along.
+            fix_tail(tail, last(tail, next));
+            impl::count_retry();
+            continue;
+        }
+
+        // Skip the nodes already dequeued.
+        link_value iter = head;
+        size_t hops = 0;
+        while (next && deleted(next) && !same_node(iter, tail) &&
+                head_.load() == head) {
+            iter = next;
+            next = iter->next_.load();
+            ++hops;
+        }
+        if (head_.load() != head) {
+            impl::count_retry();
+            continue;
+        }
+        if (same_node(iter, tail)) {
+            // Every node up to the tail is deleted, so advance the head to
+            // the tail, after which the queue is seen to be empty or its tail
+            // to have fallen behind.
+            free_chain(head, iter);
+            impl::count_retry();
+            continue;
+        }
+        if (!next) {
+            // The chain ended short of the tail, so the state changed.
+            impl::count_retry();
+            continue;
+        }
+
+        // Copy out the first node's value and mark it deleted.
+        // If T's copy assignment operator throws, the queue state is unchanged.
+        value = next->value_.get();
+        if (iter->next_.compare_set_strong(next,
+                mark(next, next_basket(basket(next)), true))) {
+            if (hops >= MAX_HOPS)
+                free_chain(head, next);
+            return true;
+        }
+        impl::count_retry();
+    }
+}
+
+template <typename T, typename Allocator>
+bool baskets_queue<T, Allocator>::empty() const
+{
+    for (link_value i = head_.load(); ; ) {
+        const link_value next = i->next_.load();
+        if (!next)
+            return true;
+        if (!deleted(next))
+            return false;
+        i = next;
+    }
+}
+
+} // namespace lf
+} // namespace mu
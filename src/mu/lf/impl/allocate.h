@@ -0,0 +1,56 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace mu {
+namespace lf {
+namespace impl {
+
+/// Allocate and construct an object using an allocator.
+///
+/// \param a An allocator for objects of the type to construct.  The pointer
+///        type must be a raw pointer for use with \c mu::tagged_ptr.
+/// \param args Constructor arguments.
+/// \return the new object.
+/// \exception Those raised by allocation and construction, in which case no
+///            memory is leaked.
+template <typename Allocator, typename... Args>
+typename std::allocator_traits<Allocator>::value_type* new_object(
+        Allocator& a,
+        Args&&... args)
+{
+    using traits = std::allocator_traits<Allocator>;
+    using value_type = typename traits::value_type;
+    static_assert(
+            std::is_same<typename traits::pointer, value_type*>::value,
+            "allocator pointer type must be a raw pointer");
+
+    value_type* p = traits::allocate(a, 1);
+    try {
+        traits::construct(a, p, std::forward<Args>(args)...);
+    } catch (...) {
+        traits::deallocate(a, p, 1);
+        throw;
+    }
+    return p;
+}
+
+/// Destroy and deallocate an object created by \c new_object.
+template <typename Allocator>
+void delete_object(
+        Allocator& a,
+        typename std::allocator_traits<Allocator>::value_type* p) noexcept
+{
+    using traits = std::allocator_traits<Allocator>;
+    traits::destroy(a, p);
+    traits::deallocate(a, p, 1);
+}
+
+} // namespace impl
+} // namespace lf
+} // namespace mu
@@ -0,0 +1,94 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace mu {
+namespace lf {
+namespace impl {
+
+/// \c std::true_type iff \c T may be stored in and loaded from a node by
+/// copying its bytes, without initialization, resetting or exception handling.
+template <typename T>
+using is_trivial_value = std::integral_constant<bool,
+        std::is_trivially_copyable<T>::value &&
+        std::is_trivially_destructible<T>::value>;
+
+/// The value held by a container node.
+///
+/// Values are value initialized, assigned under exception protection and reset
+/// to \c T() when removed, so that pooled nodes hold no resources.  The
+/// Michael-Scott queues are the exception: a delayed dequeuer may still be
+/// copying a freed node's value, so it's held until the node is reused or
+/// destroyed.
+template <typename T, bool Trivial = is_trivial_value<T>::value>
+class node_value {
+public:
+    node_value() : value_() {}
+    explicit node_value(const T& v) : value_(v) {}
+    explicit node_value(T&& v) : value_(std::move(v)) {}
+    node_value(const node_value&) = delete;
+    node_value& operator=(const node_value&) = delete;
+
+    T& get() { return value_; }
+    const T& get() const { return value_; }
+
+    /// Assign \c v, invoking \c undo before rethrowing if assignment throws.
+    template <typename U, typename Undo>
+    void store(U&& v, Undo undo)
+    {
+        try {
+            value_ = std::forward<U>(v);
+        } catch (...) {
+            undo();
+            throw;
+        }
+    }
+
+    /// Assign \c v.
+    template <typename U>
+    void store(U&& v) { value_ = std::forward<U>(v); }
+
+    /// Release any resources held by the value.
+    void reset() { value_ = T(); }
+
+private:
+    T value_;
+};
+
+/// The value held by a container node, for trivially copyable \c T.
+///
+/// Pooled nodes are left uninitialized, values are copied with \c memcpy, which
+/// can't throw, and needn't be reset when removed.
+template <typename T>
+class node_value<T, true> {
+public:
+    node_value() {}
+    explicit node_value(const T& v) : value_(v) {}
+    node_value(const node_value&) = delete;
+    node_value& operator=(const node_value&) = delete;
+
+    T& get() { return value_; }
+    const T& get() const { return value_; }
+
+    template <typename Undo>
+    void store(const T& v, Undo) { store(v); }
+
+    void store(const T& v) { std::memcpy(&value_, &v, sizeof(T)); }
+
+    void reset() {}
+
+private:
+    // A union member isn't default constructed.
+    union {
+        T value_;
+    };
+};
+
+} // namespace impl
+} // namespace lf
+} // namespace mu
@@ -8,6 +8,7 @@
 #include <cstddef>
 #include <iostream>
 
+#include <mu/lf/stats.h>
 #include <mu/tagged_ptr.h>
 
 namespace mu {
@@ -32,10 +33,14 @@ namespace impl {
 ///         been freed by the caller and is no longer valid  memory.
 ///
 /// \tparam T Must be linkable to another instance of T by defining a public
-///         field \c std::atomic<T*> \c next_.
-template <typename T>
+///         field \c Link \c next_.
+/// \tparam Link The atomic link type, \c mu::tagged_ptr<T> or
+///         \c mu::lf::tagged_index<T>, with snapshots of type \c Link::value.
+template <typename T, typename Link = tagged_ptr<T>>
 class stack {
 public:
+    using value = typename Link::value;
+
     /// \pre  \c std::atomic<T*>::is_lock_free() is \c true.
     stack() : head_(nullptr) { assert(head_.is_lock_free()); }
     stack(const stack&) = delete;
@@ -44,7 +49,7 @@ public:
     ~stack() { assert(empty()); }
 
     /// \param t a valid pointer to a \c T t.
-    void push(tagged_ptr<T> t);
+    void push(value t);
 
     /// Attempt to pop the top of the stack.
     ///
@@ -52,7 +57,7 @@ public:
     /// \return \c true iff successful.
     ///
     /// \post \code out == nullptr || out->next_ == nullptr \endcode
-    bool pop(tagged_ptr<T>& out);
+    bool pop(value& out);
 
     bool empty() const { return !head_; }
 
@@ -60,43 +65,45 @@ public:
     void for_each(const std::function<void (T*)>& ) const;
 
 private:
-    tagged_ptr<T> head_;
+    Link head_;
 };
 
-template <typename T>
-void stack<T>::push(tagged_ptr<T> e)
+template <typename T, typename Link>
+void stack<T, Link>::push(value e)
 {
     while (true) {
         // Link the new element to a snapshot of the head. Attempt to make the
         // new element the head, or repeat if the snapshot has been invalidated.
-        auto h = head_;
+        auto h = head_.load();
         e->next_ = h;
         if (head_.compare_set_strong(h, e.increment_tag()))
             break;
+        count_retry();
     }
 }
 
-template <typename T>
-bool stack<T>::pop(tagged_ptr<T>& e)
+template <typename T, typename Link>
+bool stack<T, Link>::pop(value& e)
 {
     while (true) {
         // Snapshot head pointer before attempting to detach the head element by
         // setting the heade pointer to snapshot's next pointer.
-        auto h = head_;
+        auto h = head_.load();
         if (!h)
             return false;                                       // Empty stack.
-        auto n = h->next_;
+        auto n = h->next_.load();
         if (head_.compare_set_strong(h, n.increment_tag())) {
             e = h;
             return true;
         }
+        count_retry();
     }
 }
 
-template <typename T>
-void stack<T>::for_each(const std::function<void (T*)>& f) const
+template <typename T, typename Link>
+void stack<T, Link>::for_each(const std::function<void (T*)>& f) const
 {
-    for (auto t = head_; t != nullptr; t = t->next_)
+    for (auto t = head_.load(); t; t = t->next_.load())
         f(t);
 }
 
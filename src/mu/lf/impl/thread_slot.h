@@ -0,0 +1,103 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace mu {
+namespace lf {
+namespace impl {
+
+/// The process wide registry of small, dense thread identifiers, by which
+/// wait-free containers index their per-thread state.
+///
+/// A slot is acquired by a thread on first use and released on its exit, for
+/// reuse by later threads, so the slots in use stay below the peak number of
+/// concurrent threads rather than the total ever started.
+class thread_slots {
+public:
+    constexpr static const size_t MAX_SLOTS = 512;
+
+    /// \return the registry, never destroyed so that it outlives the
+    ///         thread local slots of every thread.
+    static thread_slots& instance()
+    {
+        static thread_slots* const s = new thread_slots;
+        return *s;
+    }
+
+    /// \return the lowest free slot, now in use.
+    /// \exception std::length_error if all \c MAX_SLOTS are in use.
+    size_t acquire();
+
+    /// Free \c slot, acquired by \c acquire().
+    void release(size_t slot) noexcept;
+
+    /// \return one more than the highest slot ever acquired.
+    size_t high_water() const
+    {
+        return high_water_.load(std::memory_order_acquire);
+    }
+
+private:
+    constexpr static const size_t WORD_BITS = 64;
+
+    thread_slots() : high_water_(0)
+    {
+        for (auto& w : used_) {
+            w.store(0, std::memory_order_relaxed);
+        }
+    }
+    thread_slots(const thread_slots&) = delete;
+    thread_slots& operator=(const thread_slots&) = delete;
+
+    std::atomic<uint64_t> used_[MAX_SLOTS / WORD_BITS]; /// Bit set of slots.
+    std::atomic<size_t> high_water_;
+};
+
+inline size_t thread_slots::acquire()
+{
+    for (size_t i = 0; i < MAX_SLOTS / WORD_BITS; ++i) {
+        uint64_t w = used_[i].load(std::memory_order_relaxed);
+        while (~w != 0) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctzll(~w));
+            if (used_[i].compare_exchange_weak(w, w | uint64_t(1) << bit,
+                    std::memory_order_acq_rel)) {
+                const size_t slot = i * WORD_BITS + bit;
+                size_t h = high_water_.load(std::memory_order_relaxed);
+                while (h < slot + 1 && !high_water_.compare_exchange_weak(
+                        h, slot + 1, std::memory_order_acq_rel)) {
+                }
+                return slot;
+            }
+        }
+    }
+    throw std::length_error("mu::lf thread slots exhausted");
+}
+
+inline void thread_slots::release(size_t const slot) noexcept
+{
+    used_[slot / WORD_BITS].fetch_and(~(uint64_t(1) << slot % WORD_BITS),
+            std::memory_order_release);
+}
+
+/// \return the calling thread's slot, acquired on first use.
+/// \exception std::length_error as \c thread_slots::acquire().
+inline size_t thread_slot()
+{
+    struct holder {
+        holder() : slot(thread_slots::instance().acquire()) {}
+        ~holder() { thread_slots::instance().release(slot); }
+        const size_t slot;
+    };
+    static thread_local holder h;
+    return h.slot;
+}
+
+} // namespace impl
+} // namespace lf
+} // namespace mu
@@ -0,0 +1,127 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include <mu/lf/impl/allocate.h>
+#include <mu/lf/tagged_index.h>
+#include <mu/tagged_ptr.h>
+
+namespace mu {
+namespace lf {
+
+/// Storage policy linking container nodes by \c mu::tagged_ptr, allocating
+/// them with the container's allocator.
+///
+/// Nodes are aligned to \c 2^LowBits bytes, so the tag takes those low bits
+/// as well as the unused high ones.  Each low bit doubles the updates of a
+/// link before its tag wraps, at the cost of padding nodes whose natural
+/// alignment is less.
+///
+/// \tparam LowBits The low tag bits, at most those of the alignment of
+///         \c std::max_align_t, which allocators guarantee.
+template <unsigned LowBits>
+struct tagged_pointer_links {
+    static_assert(size_t(1) << LowBits <= alignof(std::max_align_t),
+            "node alignment exceeds allocator guarantees");
+
+    constexpr static const size_t NODE_ALIGNMENT = size_t(1) << LowBits;
+
+    template <typename Node>
+    using link = tagged_ptr<Node, LowBits>;
+};
+
+/// The default storage policy, tagging the low bits free in pointers to
+/// pointer aligned nodes, which needs no padding.
+///
+/// On x86_64 links carry a 19-bit tag, or 10-bit with 57-bit addresses.
+using pointer_links = tagged_pointer_links<arch::POINTER_LOW_BITS>;
+
+/// Storage policy linking container nodes by \c mu::lf::tagged_index, 32-bit
+/// indices into a slab shared by all containers of the node type, each packed
+/// with a 32-bit tag into a 64-bit word.
+///
+/// The tags take 2^32 updates of a link to wrap, rather than 2^19, making ABA
+/// wraparound practically impossible.  Nodes aren't allocated with the
+/// container's allocator, and at most 2^32-1 exist per node type.
+struct index_links {
+    constexpr static const size_t NODE_ALIGNMENT = 1;
+
+    template <typename Node>
+    using link = tagged_index<Node>;
+};
+
+namespace impl {
+
+/// \return the alignment of a node of \c Members, at least that \c Links
+///         requires, for a single \c alignas.
+template <typename Links, typename... Members>
+constexpr size_t node_alignment()
+{
+    return std::max({Links::NODE_ALIGNMENT, alignof(Members)...});
+}
+
+/// Creates and destroys container nodes as \c Links specifies.
+template <typename Node, typename Allocator, typename Links>
+class node_pool;
+
+/// Nodes allocated with \c Allocator.
+template <typename Node, typename Allocator, unsigned LowBits>
+class node_pool<Node, Allocator, tagged_pointer_links<LowBits>> {
+public:
+    using value = tagged_value<Node, LowBits>;
+
+    explicit node_pool(const Allocator& a) : allocator_(a) {}
+
+    /// \return a node constructed from \c args.
+    template <typename... Args>
+    value create(Args&&... args)
+    {
+        return value(new_object(allocator_, std::forward<Args>(args)...));
+    }
+
+    void destroy(value v) noexcept { delete_object(allocator_, v); }
+
+    const Allocator& get_allocator() const { return allocator_; }
+
+private:
+    Allocator allocator_;
+};
+
+/// Nodes allocated from the slab of \c Node.
+template <typename Node, typename Allocator>
+class node_pool<Node, Allocator, index_links> {
+public:
+    using value = tagged_index_value<Node>;
+
+    explicit node_pool(const Allocator& a) : allocator_(a) {}
+
+    /// \return a node constructed from \c args.
+    template <typename... Args>
+    value create(Args&&... args)
+    {
+        return slab<Node>::instance().create(std::forward<Args>(args)...);
+    }
+
+    /// Reset the node's value, which the slab would otherwise keep alive, and
+    /// return the node to the slab.
+    void destroy(value v) noexcept
+    {
+        v->value_.reset();
+        slab<Node>::instance().destroy(v);
+    }
+
+    const Allocator& get_allocator() const { return allocator_; }
+
+private:
+    Allocator allocator_;   /// Unused but for \c get_allocator().
+};
+
+} // namespace impl
+} // namespace lf
+} // namespace mu
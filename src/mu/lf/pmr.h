@@ -0,0 +1,73 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+/// Aliases of the lock-free containers allocating from polymorphic memory
+/// resources, apart from the containers so that using them alone doesn't
+/// require \c <memory_resource> or \c <experimental/memory_resource>.
+
+#include <mu/lf/baskets_queue.h>
+#include <mu/lf/queue.h>
+#include <mu/lf/sharded_queue.h>
+#include <mu/lf/stack.h>
+#include <mu/lf/two_lock_queue.h>
+#include <mu/lf/wait_free_queue.h>
+#include <mu/memory_resource.h>
+
+namespace mu {
+namespace lf {
+namespace pmr {
+
+/// A \c mu::lf::queue allocating from a \c mu::pmr::memory_resource, e.g.
+/// \code mu::lf::pmr::queue<T> q(capacity, &resource); \endcode
+///
+/// The resource must be safe for concurrent use, e.g.
+/// \c synchronized_pool_resource, as nodes are allocated by pushing threads
+/// whenever the free list is exhausted.
+template <typename T>
+using queue = mu::lf::queue<T, ::mu::pmr::polymorphic_allocator<T>>;
+
+/// A \c mu::lf::stack allocating from a \c mu::pmr::memory_resource.
+///
+/// The resource must be safe for concurrent use.
+/// \see \c mu::lf::pmr::queue
+template <typename T>
+using stack = mu::lf::stack<T, ::mu::pmr::polymorphic_allocator<T>>;
+
+/// A \c mu::lf::two_lock_queue allocating from a \c mu::pmr::memory_resource.
+///
+/// The resource must be safe for concurrent use.
+/// \see \c mu::lf::pmr::queue
+template <typename T, typename Lock = ticket_spinlock>
+using two_lock_queue = mu::lf::two_lock_queue<
+        T, Lock, ::mu::pmr::polymorphic_allocator<T>>;
+
+/// A \c mu::lf::baskets_queue allocating from a \c mu::pmr::memory_resource.
+///
+/// The resource must be safe for concurrent use.
+/// \see \c mu::lf::pmr::queue
+template <typename T>
+using baskets_queue =
+        mu::lf::baskets_queue<T, ::mu::pmr::polymorphic_allocator<T>>;
+
+/// A \c mu::lf::wait_free_queue allocating from a
+/// \c mu::pmr::memory_resource.
+///
+/// The resource must be safe for concurrent use.
+/// \see \c mu::lf::pmr::queue
+template <typename T>
+using wait_free_queue =
+        mu::lf::wait_free_queue<T, ::mu::pmr::polymorphic_allocator<T>>;
+
+/// A \c mu::lf::sharded_queue allocating from a \c mu::pmr::memory_resource.
+///
+/// The resource must be safe for concurrent use.
+/// \see \c mu::lf::pmr::queue
+template <typename T>
+using sharded_queue =
+        mu::lf::sharded_queue<T, ::mu::pmr::polymorphic_allocator<T>>;
+
+} // namespace pmr
+} // namespace lf
+} // namespace mu
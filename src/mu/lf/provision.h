@@ -0,0 +1,111 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace mu {
+namespace lf {
+
+/// How a container provisions the nodes of its initial capacity.
+enum class provision {
+    /// Allocate every node on construction, on the constructing thread.
+    eager,
+
+    /// Allocate every node on construction, dividing the work between up to
+    /// \c std::thread::hardware_concurrency() threads.  The allocator must be
+    /// safe for concurrent use, as the containers already require.
+    parallel,
+
+    /// Allocate nodes in batches of \c impl::LAZY_BATCH as the free list is
+    /// exhausted, until the initial capacity has been provisioned, so
+    /// construction takes constant time.
+    lazy
+};
+
+namespace impl {
+
+/// The number of nodes provisioned at once by \c provision::lazy.
+constexpr static const size_t LAZY_BATCH = 256;
+
+/// The fewest nodes worth starting a thread for with \c provision::parallel.
+constexpr static const size_t PARALLEL_MIN_BATCH = 16384;
+
+/// Provision \c count nodes as specified by \c p.
+///
+/// \param provide invoked as \c provide(n) to allocate \c n nodes onto the free
+///        list, concurrently with \c provision::parallel.
+/// \param reserve set to the nodes yet to be provisioned, for \c claim.
+/// \exception Those raised by \c provide, once every thread has finished.
+template <typename Provide>
+void provision_nodes(
+        const provision p,
+        const size_t count,
+        std::atomic<size_t>& reserve,
+        Provide provide)
+{
+    reserve = 0;
+    if (p == provision::lazy) {
+        reserve = count;
+        return;
+    }
+
+    size_t thread_count = 1;
+    if (p == provision::parallel) {
+        thread_count = std::max<size_t>(1, std::min<size_t>(
+                std::thread::hardware_concurrency(),
+                count / PARALLEL_MIN_BATCH));
+    }
+
+    // Provide a share on the calling thread too, then raise the first
+    // exception thrown by any.
+    std::vector<std::exception_ptr> errors(thread_count);
+    auto share = [&](size_t i) {
+        try {
+            provide(count / thread_count + (i < count % thread_count ? 1 : 0));
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    // Reserve first, as running threads mustn't be destroyed joinable if
+    // growing the vector throws.
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) {
+        try {
+            threads.emplace_back(share, i);
+        } catch (const std::system_error&) {
+            share(i);
+        }
+    }
+    share(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (const auto& e : errors) {
+        if (e)
+            std::rethrow_exception(e);
+    }
+}
+
+/// Claim up to \c batch nodes from those yet to be provisioned.
+///
+/// \return the number claimed, zero once the reserve is exhausted.
+inline size_t claim(std::atomic<size_t>& reserve, const size_t batch)
+{
+    size_t r = reserve.load(std::memory_order_relaxed);
+    while (r > 0 && !reserve.compare_exchange_weak(r, r - std::min(r, batch))) {
+    }
+    return std::min(r, batch);
+}
+
+} // namespace impl
+} // namespace lf
+} // namespace mu
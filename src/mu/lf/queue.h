@@ -6,8 +6,14 @@
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <memory>
 
+#include <mu/lf/impl/allocate.h>
+#include <mu/lf/impl/node_value.h>
+#include <mu/lf/links.h>
+#include <mu/lf/provision.h>
 #include <mu/lf/stack.h>
+#include <mu/lf/stats.h>
 #include <mu/optional.h>
 
 namespace mu {
@@ -20,9 +26,12 @@ namespace lf {
 /// implementation uses a lock-free stack for the node free list.
 ///
 /// Memory is allocated on construction to provide initial capacity.  Allocation
-/// and deallocation are not required if this capacity is not exceeded.
+/// and deallocation are not required if this capacity is not exceeded.  Large
+/// capacities may be provisioned in parallel, or lazily, see \c provision.
 ///
-/// Mutating methods provide the strong exception safety guarantee.
+/// Mutating methods provide the strong exception safety guarantee.  For
+/// trivially copyable \c T, values are copied without exception handling and
+/// pooled nodes are left uninitialized.
 ///
 /// Raised exceptions are limited to memory allocation exceptions and those
 /// thrown by \c T's copy and move constructors and assignment operators.
@@ -30,6 +39,10 @@ namespace lf {
 /// \tparam T must be default constructable, assignable and copy constructable.
 //          To realize maximum efficiency, T should be move assignable and
 ///         constructable.
+/// \tparam Allocator Rebound to allocate the queue's nodes and those of its
+///         free list.  Must be safe for concurrent use and have raw pointers.
+/// \tparam Links How nodes are stored and linked, \c pointer_links,
+///         \c tagged_pointer_links for more tag bits, or \c index_links.
 ///
 /// \internal The implementation is based on "Simple, Fast, and Practical
 ///           Non-Blocking and Blocking Concurrent Queue Algorithms" by Michael
@@ -38,13 +51,17 @@ namespace lf {
 ///
 /// \internal Providing strong exception safety requires protection where T
 ///           methods are invoked and when allocating and freeing memory.
-template <typename T>
+template <
+        typename T,
+        typename Allocator = std::allocator<T>,
+        typename Links = pointer_links>
 class queue {
 private:
     struct node;
 
 public:
     using value_type = T;
+    using allocator_type = Allocator;
 
     constexpr static const size_t DEFAULT_INITIAL_CAPACITY = 8192;
 
@@ -53,11 +70,21 @@ public:
     /// \param initial_capacity the initial capacity in number of nodes.  The
     ///        total is roughly \code initial_capacity * (sizeof(T) +
     //         sizeof(T*)) \endcode bytes.
-    queue(size_t initial_capacity);
+    /// \param a the allocator from which nodes are allocated.
+    queue(size_t initial_capacity, const Allocator& a = Allocator());
+
+    /// Construct with the specified initial capacity, provisioned as \c p
+    /// specifies.
+    queue(size_t initial_capacity,
+            provision p,
+            const Allocator& a = Allocator());
 
     /// Construct with the default initial capacity.
     queue();
 
+    /// Construct with the default initial capacity.
+    explicit queue(const Allocator& a);
+
     /// \pre \c empty() is \c true
     ~queue();
     queue& operator=(const queue&) = delete;
@@ -91,57 +118,91 @@ public:
 
     size_t capacity() const { return capacity_; }
 
+    allocator_type get_allocator() const
+    {
+        return allocator_type(pool_.get_allocator());
+    }
+
     void print(std::ostream&) const;
 
 private:
     template<typename>
     friend std::ostream& operator<<(std::ostream&, const queue&);
 
+    using link = typename Links::template link<node>;
+    using link_value = typename link::value;
+
     /// A queue node.  Linkable for instrusive \c mu::lf::stack use.
-    struct node {
-        node() : value_(), next_(nullptr) {}
-        T value_;
-        tagged_ptr<node> next_;
+    struct alignas(impl::node_alignment<Links, link, impl::node_value<T>>())
+            node {
+        node() : next_(nullptr) {}
+        impl::node_value<T> value_;
+        link next_;
     };
 
+    using traits = std::allocator_traits<Allocator>;
+    using node_allocator = typename traits::template rebind_alloc<node>;
+    using free_list = stack<
+            link_value,
+            typename traits::template rebind_alloc<link_value>,
+            Links>;
+
     void destroy() noexcept;            /// Free all instance resources.
-    tagged_ptr<node> alloc_node();      /// Return a free or newly allocated node.
-    void free_node(tagged_ptr<node>);   /// Release to pool of free nodes.
+    void provide(size_t);               /// Allocate nodes onto the free list.
+    link_value alloc_node();    /// Return a free or new node.
+    void free_node(link_value); /// Release to pool of free nodes.
     bool dequeue(T&);
-    void enqueue(tagged_ptr<node>) noexcept;
+    void enqueue(link_value) noexcept;
 
+    impl::node_pool<node, node_allocator, Links> pool_; /// Node allocation.
     std::atomic<size_t> capacity_;  /// Total capacity, free + used nodes.
-    tagged_ptr<node> head_;         /// Sentinel.  head_->next_ points to first.
-    tagged_ptr<node> tail_;         /// Tail.  Points head_->next_ if empty.
-    stack<tagged_ptr<node>> free_;  /// Free node list.
+    std::atomic<size_t> reserve_;   /// Capacity yet to be provisioned.
+    link head_;                     /// Sentinel.  head_->next_ points to first.
+    link tail_;                     /// Tail.  Points head_->next_ if empty.
+    free_list free_;                /// Free node list.
 };
 
-template <typename T>
-void queue<T>::destroy() noexcept
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::destroy() noexcept
 {
     assert(empty());
 
     while (!free_.empty()) {
-        tagged_ptr<node> n;
+        link_value n;
         free_.pop(n);
-        delete n;
+        pool_.destroy(n);
     }
+    if (head_)
+        pool_.destroy(head_.load());
 }
 
-template <typename T>
-queue<T>::queue(size_t const initial_capacity_count) :
+template <typename T, typename Allocator, typename Links>
+queue<T, Allocator, Links>::queue(
+        size_t const initial_capacity_count,
+        const Allocator& a) :
+        queue(initial_capacity_count, provision::eager, a)
+{
+}
+
+template <typename T, typename Allocator, typename Links>
+queue<T, Allocator, Links>::queue(
+        size_t const initial_capacity_count,
+        provision const p,
+        const Allocator& a) :
+        pool_(node_allocator(a)),
         capacity_(initial_capacity_count),
+        reserve_(0),
         head_(),
         tail_(),
-        free_()
+        free_(free_list::DEFAULT_INITIAL_CAPACITY,
+                p == provision::lazy ? provision::lazy : provision::eager,
+                a)
 {
     // Provision initial, free capacity.
     try {
-        for (size_t i = 0; i < initial_capacity_count; ++i) {
-            tagged_ptr<node> n(new node());
-            free_.push(n);
-        }
-        tagged_ptr<node> n(alloc_node());
+        impl::provision_nodes(p, initial_capacity_count, reserve_,
+                [this](size_t count) { provide(count); });
+        link_value n(alloc_node());
         head_ = n;
         tail_ = n;
     } catch (...) {
@@ -150,68 +211,89 @@ queue<T>::queue(size_t const initial_capacity_count) :
     }
 }
 
-template <typename T> queue<T>::queue() : queue(DEFAULT_INITIAL_CAPACITY) {}
+template <typename T, typename Allocator, typename Links>
+queue<T, Allocator, Links>::queue() : queue(DEFAULT_INITIAL_CAPACITY) {}
+
+template <typename T, typename Allocator, typename Links>
+queue<T, Allocator, Links>::queue(const Allocator& a) :
+        queue(DEFAULT_INITIAL_CAPACITY, a)
+{
+}
+
+template <typename T, typename Allocator, typename Links>
+queue<T, Allocator, Links>::~queue() { destroy(); }
 
-template <typename T> queue<T>::~queue() { destroy(); }
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::provide(size_t const count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        link_value n(pool_.create());
+        try {
+            free_.push(n);
+        } catch (...) {
+            pool_.destroy(n);
+            throw;
+        }
+    }
+}
 
-template <typename T>
-tagged_ptr<typename queue<T>::node> queue<T>::alloc_node()
+template <typename T, typename Allocator, typename Links>
+typename queue<T, Allocator, Links>::link_value
+queue<T, Allocator, Links>::alloc_node()
 {
-    tagged_ptr<node> n;
-    if (!free_.pop(n)) {
-        n = new node();
-        ++capacity_;
+    link_value n;
+    while (!free_.pop(n)) {
+        // Provision a batch of any reserved capacity, else grow.
+        const size_t reserved = impl::claim(reserve_, impl::LAZY_BATCH);
+        if (reserved == 0) {
+            n = pool_.create();
+            ++capacity_;
+            break;
+        }
+        provide(reserved);
     }
     return n;
 }
 
 
-template <typename T>
-void queue<T>::free_node(tagged_ptr<node> e)
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::free_node(link_value e)
 {
     free_.push(e);
 }
 
-template <typename T>
-void queue<T>::push(T const & value)
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::push(T const & value)
 {
-    tagged_ptr<node> n = alloc_node();
-    try {
-        n->value_ = value;
-    } catch (...) {
-        free_node(n);
-        throw;
-    }
+    link_value n = alloc_node();
+    n->value_.store(value, [&] { free_node(n); });
     enqueue(n);
 }
 
-template <typename T>
-void queue<T>::emplace(T&& value)
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::emplace(T&& value)
 {
-    tagged_ptr<node> n = alloc_node();
-    try {
-        n->value_ = std::move(value);
-    } catch (...) {
-        delete n;
-        throw;
-    }
+    link_value n = alloc_node();
+    n->value_.store(std::move(value), [&] { free_node(n); });
     enqueue(n);
 }
 
-template <typename T>
-void queue<T>::enqueue(tagged_ptr<node> const n) noexcept
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::enqueue(link_value const n) noexcept
 {
-    tagged_ptr<node> tail;
-    tagged_ptr<node> next;
+    link_value tail;
+    link_value next;
     n->next_ = nullptr;
 
     while (true) {
-        tail = tail_;
-        next = tail->next_;
+        tail = tail_.load();
+        next = tail->next_.load();
 
         // Verify read of tail_ and tail_->next_ is consistent.
-        if (tail != tail_)
+        if (tail != tail_.load()) {
+            impl::count_retry();
             continue;
+        }
 
         if (!next) {
             // Attempt to link in the new node.
@@ -220,18 +302,19 @@ void queue<T>::enqueue(tagged_ptr<node> const n) noexcept
         } else {
             // The tail pointer has fallen behind, attempt to move it along.
             tail_.compare_set_strong(tail, next.set_tag(tail).increment_tag());
-            continue;
         }
+        impl::count_retry();
     }
 
     // If this update fails, the next en/dequeue will update the tail pointer.
     tail_.compare_set_strong(tail, n.set_tag(tail).increment_tag());
 }
 
-template <typename T> bool queue<T>::pop(T& out) { return dequeue(out); }
+template <typename T, typename Allocator, typename Links>
+bool queue<T, Allocator, Links>::pop(T& out) { return dequeue(out); }
 
-template <typename T>
-optional<T> queue<T>::pop()
+template <typename T, typename Allocator, typename Links>
+optional<T> queue<T, Allocator, Links>::pop()
 {
     using std::experimental::make_optional;
     using std::move;
@@ -242,18 +325,20 @@ optional<T> queue<T>::pop()
     return optional<T>();
 }
 
-template <typename T>
-bool queue<T>::dequeue(T& value)
+template <typename T, typename Allocator, typename Links>
+bool queue<T, Allocator, Links>::dequeue(T& value)
 {
     while (true) {
         // Read the state in an order allowing consistency verification.
-        tagged_ptr<node> h = head_;     // The (h)ead.
-        tagged_ptr<node> t = tail_;     // The (t)ail.
-        tagged_ptr<node> n = h->next_;  // The (n)ext node.
+        link_value h = head_.load();    // The (h)ead.
+        link_value t = tail_.load();    // The (t)ail.
+        link_value n = h->next_.load(); // The (n)ext node.
 
         // Verify read of head_, tail_ and head_->next_ is consistent.
-        if (h != head_)
+        if (h != head_.load()) {
+            impl::count_retry();
             continue;
+        }
 
         if (h == t) {
             if (!n) {
@@ -262,6 +347,7 @@ bool queue<T>::dequeue(T& value)
             } else {
                 // The tail pointer has fallen behind, attempt to move it along.
                 tail_.compare_set_strong(t, n.set_tag(t).increment_tag());
+                impl::count_retry();
                 continue;
             }
         }
@@ -270,34 +356,37 @@ bool queue<T>::dequeue(T& value)
 
         // Copy out the first node's value and dequeue it.
         // If T's copy assignment operator throws, the queue state is unchanged.
-        value = n->value_;
+        value = n->value_.get();
         auto old = h;
-        if (!head_.compare_set_strong(h, n.set_tag(h.increment_tag())))
+        if (!head_.compare_set_strong(h, n.set_tag(h.increment_tag()))) {
+            impl::count_retry();
             continue;
+        }
 
-        // Free the old head.
+        // Free the old head.  Its value isn't reset, since a delayed dequeuer
+        // may still be copying it.
         free_node(old);
         return true;
     }
 }
 
-template <typename T>
-bool queue<T>::empty() const
+template <typename T, typename Allocator, typename Links>
+bool queue<T, Allocator, Links>::empty() const
 {
-    return head_ == tail_;
+    return head_.load() == tail_.load();
 }
 
-template <typename T>
-void queue<T>::print(std::ostream& os) const
+template <typename T, typename Allocator, typename Links>
+void queue<T, Allocator, Links>::print(std::ostream& os) const
 {
     os << "q={";
-    for (auto i = head_; i != nullptr; i = i->next_)
-        os << i->value_.id_ << ", ";
+    for (auto i = head_.load(); i; i = i->next_.load())
+        os << i->value_.get().id_ << ", ";
     os << "}";
 }
 
-template <typename T>
-std::ostream& operator<<(std::ostream& os, const queue<T>& q)
+template <typename T, typename Allocator, typename Links>
+std::ostream& operator<<(std::ostream& os, const queue<T, Allocator, Links>& q)
 {
     q.print(os);
     return os;
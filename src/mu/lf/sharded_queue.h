@@ -0,0 +1,331 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/impl/allocate.h>
+#include <mu/lf/impl/thread_slot.h>
+#include <mu/lf/provision.h>
+#include <mu/lf/queue.h>
+#include <mu/optional.h>
+
+namespace mu {
+namespace lf {
+
+namespace impl {
+
+/// \return the CPU the calling thread is running on, where supported, else
+///         its thread slot.
+inline size_t current_cpu()
+{
+#if defined(__linux__)
+    const int cpu = sched_getcpu();
+    if (cpu >= 0)
+        return static_cast<size_t>(cpu);
+#endif
+    return thread_slot();
+}
+
+/// \return a pseudo-random index less than \c n, from a thread local
+///         xorshift generator.
+inline size_t random_index(size_t n)
+{
+    static thread_local uint64_t x = reinterpret_cast<uintptr_t>(&x) | 1;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return static_cast<size_t>(x % n);
+}
+
+} // namespace impl
+
+/// A lock-free, multi-producer multi-consumer, unbounded queue relaxing FIFO
+/// order for throughput, sharing the interface of \c mu::lf::queue.
+///
+/// Elements are held in shards, each a \c mu::lf::queue, one per CPU by
+/// default.  Producers push to the shard of the CPU they're running on, or a
+/// hinted one, and consumers pop from it, or a hinted one, first, stealing
+/// from the others in turn from a random one when it's empty.  Threads spread
+/// over the CPUs so mostly use separate shards, rather than all contending
+/// for one head and tail.
+///
+/// The order is relaxed as follows.
+///
+/// - Elements of a shard are popped in the order pushed.  So a thread's
+///   elements are popped in the order it pushed them while it stays on one
+///   CPU, e.g. if pinned, but after migrating its later elements may be
+///   popped before its earlier ones.
+/// - Across shards elements are unordered.  An element is popped once those
+///   ahead of it in its shard are, so the elements pushed before it but
+///   popped after it, its rank error, are at most those in the other shards.
+/// - A shard whose CPU runs no consumer is popped only by stealing, when a
+///   consumer finds its own shard empty.  While every consumer's shard stays
+///   busy, its elements may wait indefinitely, unless consumers pass hints
+///   covering every shard, e.g. rotating.
+/// - \c pop() returns \c false if it found each shard empty in turn, though
+///   not necessarily at once, as does \c empty(), so neither is linearizable
+///   with concurrent pushes.
+///
+/// Mutating methods provide the exception guarantees of \c mu::lf::queue.
+///
+/// \tparam T must be default constructable, assignable and copy constructable.
+/// \tparam Allocator Rebound to allocate the shards and their nodes.  Must be
+///         safe for concurrent use and have raw pointers.
+template <typename T, typename Allocator = std::allocator<T>>
+class sharded_queue {
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+
+    constexpr static const size_t DEFAULT_INITIAL_CAPACITY = 8192;
+
+    /// Construct with the specified initial capacity, over all shards, and a
+    /// shard per CPU.
+    ///
+    /// \param initial_capacity the initial capacity in number of nodes.
+    /// \param a the allocator from which shards and nodes are allocated.
+    sharded_queue(size_t initial_capacity, const Allocator& a = Allocator());
+
+    /// Construct with the specified initial capacity, provisioned as \c p
+    /// specifies, and a shard per CPU.
+    sharded_queue(
+            size_t initial_capacity,
+            provision p,
+            const Allocator& a = Allocator());
+
+    /// Construct with the specified initial capacity, provisioned as \c p
+    /// specifies, and number of shards.
+    ///
+    /// \param shard_count at least one.
+    sharded_queue(
+            size_t initial_capacity,
+            size_t shard_count,
+            provision p,
+            const Allocator& a = Allocator());
+
+    /// Construct with the default initial capacity.
+    sharded_queue();
+
+    /// Construct with the default initial capacity.
+    explicit sharded_queue(const Allocator& a);
+
+    sharded_queue(const sharded_queue&) = delete;
+
+    /// \pre \c empty() is \c true
+    ~sharded_queue();
+    sharded_queue& operator=(const sharded_queue&) = delete;
+
+    /// Remove the head of the calling thread's shard, else of another's.
+    ///
+    /// \return \c true iff a valid, T value was assigned to \c out.
+    bool pop(T& out) { return pop(out, local_shard()); }
+
+    /// Remove the head of shard \c hint modulo \c shard_count(), else of
+    /// another's.
+    ///
+    /// \return \c true iff a valid, T value was assigned to \c out.
+    bool pop(T& out, size_t hint);
+
+    /// Remove the head of the calling thread's shard, else of another's.
+    ///
+    /// \return a valid, T value, or \c false.
+    optional<T> pop();
+
+    /// Move a value onto the calling thread's shard.
+    void emplace(T&& e) { local().emplace(std::move(e)); }
+
+    /// Copy a value onto the calling thread's shard.
+    void push(const T& e) { local().push(e); }
+
+    /// Move a value onto shard \c hint modulo \c shard_count().
+    void emplace(T&& e, size_t hint)
+    {
+        shards_[hint % shard_count()]->queue_.emplace(std::move(e));
+    }
+
+    /// Copy a value onto shard \c hint modulo \c shard_count().
+    void push(const T& e, size_t hint)
+    {
+        shards_[hint % shard_count()]->queue_.push(e);
+    }
+
+    /// \return \c true iff every shard has no nodes available for dequeueing.
+    bool empty() const;
+
+    /// \return the total capacity of the shards.
+    size_t capacity() const;
+
+    size_t shard_count() const { return shards_.size(); }
+
+    /// \return the shard the calling thread pushes to, that of its CPU.
+    size_t local_shard() const { return impl::current_cpu() % shard_count(); }
+
+    allocator_type get_allocator() const { return allocator_type(allocator_); }
+
+private:
+    constexpr static const size_t CACHE_LINE_SIZE = 64;
+
+    using shard_queue = queue<T, Allocator>;
+
+    struct shard {
+        shard(size_t capacity, provision p, const Allocator& a) :
+                queue_(capacity, p, a)
+        {
+        }
+
+        shard_queue queue_;
+
+        /// Keeps shards allocated back to back off each other's cache lines.
+        char padding_[CACHE_LINE_SIZE];
+    };
+
+    using traits = std::allocator_traits<Allocator>;
+    using shard_allocator = typename traits::template rebind_alloc<shard>;
+    using shards = std::vector<
+            shard*,
+            typename traits::template rebind_alloc<shard*>>;
+
+    /// \return the default shard count, one per CPU.
+    static size_t cpu_count()
+    {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    shard_queue& local() { return shards_[local_shard()]->queue_; }
+
+    void destroy() noexcept;        /// Free all instance resources.
+
+    shard_allocator allocator_;
+    shards shards_;
+};
+
+template <typename T, typename Allocator>
+void sharded_queue<T, Allocator>::destroy() noexcept
+{
+    for (shard* s : shards_) {
+        impl::delete_object(allocator_, s);
+    }
+    shards_.clear();
+}
+
+template <typename T, typename Allocator>
+sharded_queue<T, Allocator>::sharded_queue(
+        size_t const initial_capacity,
+        const Allocator& a) :
+        sharded_queue(initial_capacity, cpu_count(), provision::eager, a)
+{
+}
+
+template <typename T, typename Allocator>
+sharded_queue<T, Allocator>::sharded_queue(
+        size_t const initial_capacity,
+        provision const p,
+        const Allocator& a) :
+        sharded_queue(initial_capacity, cpu_count(), p, a)
+{
+}
+
+template <typename T, typename Allocator>
+sharded_queue<T, Allocator>::sharded_queue(
+        size_t const initial_capacity,
+        size_t const shard_count,
+        provision const p,
+        const Allocator& a) :
+        allocator_(a),
+        shards_(a)
+{
+    assert(shard_count > 0);
+
+    // Divide the capacity between the shards, rounding up.
+    const size_t capacity = (initial_capacity + shard_count - 1) / shard_count;
+    try {
+        shards_.reserve(shard_count);
+        for (size_t i = 0; i < shard_count; ++i) {
+            shards_.push_back(impl::new_object(allocator_, capacity, p, a));
+        }
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+template <typename T, typename Allocator>
+sharded_queue<T, Allocator>::sharded_queue() :
+        sharded_queue(DEFAULT_INITIAL_CAPACITY)
+{
+}
+
+template <typename T, typename Allocator>
+sharded_queue<T, Allocator>::sharded_queue(const Allocator& a) :
+        sharded_queue(DEFAULT_INITIAL_CAPACITY, a)
+{
+}
+
+template <typename T, typename Allocator>
+sharded_queue<T, Allocator>::~sharded_queue()
+{
+    assert(empty());
+    destroy();
+}
+
+template <typename T, typename Allocator>
+bool sharded_queue<T, Allocator>::pop(T& out, size_t const hint)
+{
+    const size_t n = shards_.size();
+    const size_t first = hint % n;
+    if (shards_[first]->queue_.pop(out))
+        return true;
+
+    // Steal, from a random shard on, so that thieves spread over the shards.
+    const size_t start = impl::random_index(n);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t victim = (start + i) % n;
+        if (victim != first && shards_[victim]->queue_.pop(out))
+            return true;
+    }
+    return false;
+}
+
+template <typename T, typename Allocator>
+optional<T> sharded_queue<T, Allocator>::pop()
+{
+    using std::experimental::make_optional;
+    using std::move;
+
+    T value;
+    if (pop(value))
+        return make_optional<T>(move(value));
+    return optional<T>();
+}
+
+template <typename T, typename Allocator>
+bool sharded_queue<T, Allocator>::empty() const
+{
+    return std::all_of(shards_.begin(), shards_.end(),
+            [](const shard* s) { return s->queue_.empty(); });
+}
+
+template <typename T, typename Allocator>
+size_t sharded_queue<T, Allocator>::capacity() const
+{
+    size_t total = 0;
+    for (const shard* s : shards_) {
+        total += s->queue_.capacity();
+    }
+    return total;
+}
+
+} // namespace lf
+} // namespace mu
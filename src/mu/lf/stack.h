@@ -6,9 +6,14 @@
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <memory>
 
 #include <mu/optional.h>
+#include <mu/lf/impl/allocate.h>
+#include <mu/lf/impl/node_value.h>
 #include <mu/lf/impl/stack.h>
+#include <mu/lf/links.h>
+#include <mu/lf/provision.h>
 
 namespace mu {
 namespace lf {
@@ -16,24 +21,39 @@ namespace lf {
 /// A lock-free unbounded stack.
 ///
 /// Memory is allocated on construction to provide initial capacity.  Allocation and
-/// deallocation are not required if this capacity is not exceeded.
+/// deallocation are not required if this capacity is not exceeded.  Large
+/// capacities may be provisioned in parallel, or lazily, see \c provision.
 ///
 /// The \c emplace(T&&) and \code option<t> pop() \endcode methods provide the
-/// strong exception safety guarantee.
+/// strong exception safety guarantee.  For trivially copyable \c T, values are
+/// copied without exception handling and popped nodes aren't reset.
 ///
 /// Raised exceptions are limited to memory allocation exceptions and those
 /// thrown by \c T's copy and move constructors and assignment operators.
 ///
 /// \tparam T The stack element value type.  Must be copy constructable and
 ///           assignable.  Should be move constructable and assignable.
-template <typename T>
+/// \tparam Allocator Rebound to allocate the stack's nodes.  Must be safe for
+///           concurrent use and have raw pointers.
+/// \tparam Links How nodes are stored and linked, \c pointer_links,
+///           \c tagged_pointer_links for more tag bits, or \c index_links.
+template <
+        typename T,
+        typename Allocator = std::allocator<T>,
+        typename Links = pointer_links>
 class stack {
 public:
     using value_type = T;
+    using allocator_type = Allocator;
     constexpr static const size_t DEFAULT_INITIAL_CAPACITY = 8192;
 
     stack() : stack(DEFAULT_INITIAL_CAPACITY)  {}
-    stack(size_t initial_capacity);
+    explicit stack(const Allocator& a) : stack(DEFAULT_INITIAL_CAPACITY, a) {}
+    stack(size_t initial_capacity, const Allocator& a = Allocator()) :
+            stack(initial_capacity, provision::eager, a) {}
+    stack(size_t initial_capacity,
+            provision p,
+            const Allocator& a = Allocator());
     stack(const stack&) = delete;
     ~stack();
     stack& operator=(const stack&) = delete;
@@ -65,114 +85,152 @@ public:
     /// Not safe for concurrent invocation.
     void for_each(const std::function<void (T&)>& ) const;
 
+    allocator_type get_allocator() const
+    {
+        return allocator_type(pool_.get_allocator());
+    }
+
 private:
-    struct node {
-        node() = default;
+    struct node;
+    using link = typename Links::template link<node>;
+    using link_value = typename link::value;
+
+    struct alignas(impl::node_alignment<Links, link, impl::node_value<T>>())
+            node {
+        node() {}
         node(T const & value) : next_(nullptr), value_(value) {}
         node(T&& value) : next_(nullptr), value_(std::move(value)) {}
         node(node const &) = delete;
         node& operator=(node const &) = delete;
         ~node() = default;
-        tagged_ptr<node> next_;
-        T value_;
+        link next_;
+        impl::node_value<T> value_;
     };
 
+    using traits = std::allocator_traits<Allocator>;
+    using node_allocator = typename traits::template rebind_alloc<node>;
+
     void destroy();
+    void provide(size_t count);     // Allocate nodes onto the free list.
+    bool pop_free(link_value& n);   // Pop or provision a free node.
 
-    impl::stack<node> free_;       // List of free nodes.
-    impl::stack<node> stack_;      // The stack implementation.
+    impl::node_pool<node, node_allocator, Links> pool_; // Node allocation.
+    impl::stack<node, link> free_;  // List of free nodes.
+    impl::stack<node, link> stack_; // The stack implementation.
+    std::atomic<size_t> reserve_;   // Capacity yet to be provisioned.
 };
 
-template <typename T>
-stack<T>::stack(size_t initial_capacity)
+template <typename T, typename Allocator, typename Links>
+stack<T, Allocator, Links>::stack(
+        size_t initial_capacity,
+        provision p,
+        const Allocator& a) :
+        pool_(node_allocator(a)),
+        reserve_(0)
 {
     try {
-        for (size_t i = 0; i < initial_capacity; ++i) {
-            tagged_ptr<node> n(new node());
-            free_.push(n);
-        }
+        impl::provision_nodes(p, initial_capacity, reserve_,
+                [this](size_t count) { provide(count); });
     } catch (...) {
         destroy();
+        throw;
+    }
+}
+
+template <typename T, typename Allocator, typename Links>
+void stack<T, Allocator, Links>::provide(size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        free_.push(pool_.create());
+    }
+}
+
+template <typename T, typename Allocator, typename Links>
+bool stack<T, Allocator, Links>::pop_free(link_value& n)
+{
+    while (!free_.pop(n)) {
+        const size_t reserved = impl::claim(reserve_, impl::LAZY_BATCH);
+        if (reserved == 0)
+            return false;
+        provide(reserved);
     }
+    return true;
 }
 
-template <typename T> stack<T>::~stack() { destroy(); }
+template <typename T, typename Allocator, typename Links>
+stack<T, Allocator, Links>::~stack() { destroy(); }
 
-template <typename T>
-void stack<T>::destroy()
+template <typename T, typename Allocator, typename Links>
+void stack<T, Allocator, Links>::destroy()
 {
     assert(empty());
 
-    tagged_ptr<node> n;
+    link_value n;
     while (free_.pop(n)) {
-        delete n;
+        pool_.destroy(n);
     }
 }
 
-template <typename T>
-void stack<T>::push(T const& v)
+template <typename T, typename Allocator, typename Links>
+void stack<T, Allocator, Links>::push(T const& v)
 {
-    tagged_ptr<node> n;
-    if (!free_.pop(n))
-        n = new node(v);
+    link_value n;
+    if (pop_free(n))
+        n->value_.store(v);
+    else
+        n = pool_.create(v);
 
-    n->value_ = v;
     stack_.push(n);
 }
 
-template <typename T>
-void stack<T>::emplace(T&& v)
+template <typename T, typename Allocator, typename Links>
+void stack<T, Allocator, Links>::emplace(T&& v)
 {
-    tagged_ptr<node> n;
-    bool allocated = false;
-    if (!free_.pop(n)) {
-        n = new node(v);
-        allocated = true;
-    }
-
-    try {
-        n->value_ = std::move(v);
+    link_value n;
+    if (!pop_free(n)) {
+        n = pool_.create(std::move(v));
         stack_.push(n);
-    } catch (...) {
-        if (allocated) {
-            delete n;
-        } else {
-            free_.push(n);
-        }
+        return;
     }
+
+    n->value_.store(std::move(v), [&] { free_.push(n); });
+    stack_.push(n);
 }
 
-template <typename T>
-bool stack<T>::pop(T& out)
+template <typename T, typename Allocator, typename Links>
+bool stack<T, Allocator, Links>::pop(T& out)
 {
-    tagged_ptr<node> n;
+    link_value n;
     if (stack_.pop(n)) {
-        out = n->value_;
-        n->value_ = T();
+        out = n->value_.get();
+        n->value_.reset();
+        free_.push(n);
         return true;
     }
     return false;
 }
 
-template <typename T>
-optional<T> stack<T>::pop()
+template <typename T, typename Allocator, typename Links>
+optional<T> stack<T, Allocator, Links>::pop()
 {
     using std::experimental::make_optional;
     using std::move;
 
-    tagged_ptr<node> n;
+    link_value n;
     optional<T> t;
     if (stack_.pop(n)) {
-        t = make_optional<T>(move(n->value_));
-        n->value_ = move(T());
+        t = make_optional<T>(move(n->value_.get()));
+        n->value_.reset();
+        free_.push(n);
     }
     return t;
 }
 
-template <typename T>
-void stack<T>::for_each(const std::function<void (T&)>& f) const
+template <typename T, typename Allocator, typename Links>
+void stack<T, Allocator, Links>::for_each(
+        const std::function<void (T&)>& f) const
 {
-    stack_.for_each([&f] (node* n) { f(n->value_); });
+    stack_.for_each([&f] (node* n) { f(n->value_.get()); });
 }
 
 } // namespace lf
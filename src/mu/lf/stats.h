@@ -0,0 +1,40 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <cstdint>
+
+namespace mu {
+namespace lf {
+
+/// Counts of a thread's retries in the lock-free containers' retry loops,
+/// e.g. after losing a compare and set race, for diagnosing contention and the
+/// starvation of unlucky threads.
+///
+/// Counting is compiled in only if \c MU_LF_STATS is defined, otherwise the
+/// counts remain zero at no cost.
+struct stats {
+    uint64_t retries;
+};
+
+/// \return the calling thread's counts.
+inline stats& thread_stats()
+{
+    static thread_local stats s = {0};
+    return s;
+}
+
+namespace impl {
+
+/// Count a retry by the calling thread, if enabled.
+inline void count_retry()
+{
+#if defined(MU_LF_STATS)
+    ++thread_stats().retries;
+#endif
+}
+
+} // namespace impl
+} // namespace lf
+} // namespace mu
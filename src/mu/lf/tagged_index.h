@@ -0,0 +1,276 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <mu/lf/impl/stack.h>
+#include <mu/packed_atomic.h>
+
+namespace mu {
+namespace lf {
+
+namespace impl {
+template <typename Node> class slab;
+} // namespace impl
+
+/// A non-atomic snapshot of a \c tagged_index, for local variables.
+///
+/// Mirrors \c mu::tagged_value, dereferencing the index through the slab of
+/// \c Node instances.
+///
+/// \tparam Node The slab allocated node type.
+template <typename Node>
+class tagged_index_value {
+public:
+    /// The index in the lower and the tag in the upper half.
+    using packed = mu::packed<field<uint32_t, 32>, field<size_t, 32>>;
+
+    constexpr static const uint64_t MAX_TAG = 0xffff'ffff;
+
+    tagged_index_value() {}
+    explicit tagged_index_value(packed p) : packed_(p) {}
+    tagged_index_value(uint32_t index, size_t tag) : packed_(index, tag) {}
+
+    /// \return a copy of this instance but with the tag set to \c o.get_tag().
+    tagged_index_value set_tag(const tagged_index_value& o) const
+    {
+        return tagged_index_value(index(), o.get_tag());
+    }
+
+    /// \return a copy of this instance with the tag = tag + 1 mod MAX_TAG.
+    tagged_index_value increment_tag() const
+    {
+        return tagged_index_value(packed_.set<1>(get_tag() + 1));
+    }
+
+    /// \return the value of the tag.
+    size_t get_tag() const { return packed_.get<1>(); }
+
+    /// \return the index of the node in the slab, zero if null.
+    uint32_t index() const { return packed_.get<0>(); }
+
+    /// \return the packed index and tag.
+    packed get_packed() const { return packed_; }
+
+    operator bool() const { return index() != 0; }
+    operator Node*() const;
+    Node& operator*() const { return *static_cast<Node*>(*this); }
+    Node* operator->() const { return *this; }
+    bool operator==(const tagged_index_value& o) const
+    {
+        return packed_ == o.packed_;
+    }
+    bool operator!=(const tagged_index_value& o) const
+    {
+        return packed_ != o.packed_;
+    }
+
+private:
+    packed packed_;
+};
+
+/// An atomic 32-bit node index packed with a 32-bit tag for counting
+/// references for ABA protection, as \c mu::tagged_ptr does for pointers.
+///
+/// Nodes are allocated from a slab shared by all containers of \c Node, so
+/// the link is a single 64-bit word, compare and set without a double width
+/// CAS, while the tag takes 2^32 rather than 2^19 updates to wrap.
+///
+/// \tparam Node The slab allocated node type.
+template <typename Node>
+class tagged_index {
+public:
+    using value = tagged_index_value<Node>;
+
+    tagged_index() {}
+    explicit tagged_index(std::nullptr_t) {}
+    explicit tagged_index(value v) : packed_(v.get_packed()) {}
+    tagged_index(const tagged_index&) = delete;
+    tagged_index& operator=(const tagged_index&) = delete;
+    tagged_index& operator=(std::nullptr_t)
+    {
+        packed_.store(typename value::packed());
+        return *this;
+    }
+    tagged_index& operator=(value v)
+    {
+        packed_.store(v.get_packed());
+        return *this;
+    }
+
+    ///\return \c true iff the atomic operations on instances are lock free.
+    bool is_lock_free() const { return packed_.is_lock_free(); }
+
+    /// \return a snapshot of the index and tag, by a single atomic load.
+    value load() const { return value(packed_.load()); }
+
+    /// Atomically compare \c this with \c expected and iff equal set former to
+    /// latter.
+    ///
+    /// \return \c true iff \c this was set to \c desired.
+    bool compare_set_strong(value expected, value desired)
+    {
+        auto e = expected.get_packed();
+        return packed_.compare_exchange_strong(e, desired.get_packed());
+    }
+
+    operator bool() const { return load(); }
+    operator Node*() const { return load(); }
+
+private:
+    packed_atomic<field<uint32_t, 32>, field<size_t, 32>> packed_;
+};
+
+namespace impl {
+
+/// The process wide slab of \c Node instances linked by \c tagged_index.
+///
+/// Nodes are default constructed a chunk at a time, chunk \c k holding
+/// \c 2^(k+FIRST_CHUNK_BITS) nodes, so indices map to stable addresses without
+/// relocation.  Released nodes are kept on a lock-free free list and reused by
+/// any container of \c Node.  Memory is retained for the life of the process.
+/// Index zero is reserved as null.
+///
+/// The chunk table is a static member, zero initialized before any dynamic
+/// initialization, so that dereferencing an index needn't check that the
+/// slab instance has been constructed.
+///
+/// \tparam Node Must be default constructable and have a
+///         \c tagged_index<Node> \c next_ field.
+template <typename Node>
+class slab {
+public:
+    constexpr static const unsigned FIRST_CHUNK_BITS = 8;
+    constexpr static const unsigned CHUNK_COUNT = 33 - FIRST_CHUNK_BITS;
+    constexpr static const uint64_t MAX_INDEX = 0xffff'ffff;
+
+    using value = tagged_index_value<Node>;
+
+    /// \return the slab, never destroyed so that static containers may
+    ///         outlive it.
+    static slab& instance()
+    {
+        static slab* const s = new slab;
+        return *s;
+    }
+
+    /// \return the node at \c index, or \c nullptr if \c index is zero.
+    static Node* at(uint32_t index);
+
+    /// \return a node constructed from \c args.
+    /// \exception std::bad_alloc if the indices are exhausted, or those raised
+    ///            by allocation and construction, in which case no node is
+    ///            leaked.
+    template <typename... Args>
+    value create(Args&&... args);
+
+    /// Return a node to the slab.
+    void destroy(value v) noexcept;
+
+private:
+    slab();
+    slab(const slab&) = delete;
+    slab& operator=(const slab&) = delete;
+
+    /// \return the chunk holding \c index and the offset within it.
+    static std::pair<unsigned, uint64_t> locate(uint64_t index);
+
+    /// \return a free, or newly allocated, default constructed node.
+    value acquire();
+
+    static std::atomic<Node*> chunks_[CHUNK_COUNT];
+    std::atomic<uint64_t> next_index_;  /// The next never allocated index.
+    stack<Node, tagged_index<Node>> free_;  /// Free nodes.
+};
+
+template <typename Node>
+std::atomic<Node*> slab<Node>::chunks_[slab<Node>::CHUNK_COUNT];
+
+template <typename Node>
+slab<Node>::slab() : next_index_(1) {}
+
+template <typename Node>
+std::pair<unsigned, uint64_t> slab<Node>::locate(uint64_t const index)
+{
+    const uint64_t i = index + (uint64_t(1) << FIRST_CHUNK_BITS);
+    const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(i));
+    const unsigned k = msb - FIRST_CHUNK_BITS;
+    return {k, i - (uint64_t(1) << msb)};
+}
+
+template <typename Node>
+Node* slab<Node>::at(uint32_t const index)
+{
+    if (index == 0)
+        return nullptr;
+    const auto l = locate(index);
+    return chunks_[l.first].load(std::memory_order_acquire) + l.second;
+}
+
+template <typename Node>
+tagged_index_value<Node> slab<Node>::acquire()
+{
+    // Reuse a free node.
+    value v;
+    if (free_.pop(v)) {
+        v->next_ = nullptr;
+        return v;
+    }
+
+    // Allocate a new node, and its chunk if this is the chunk's first.
+    const uint64_t index = next_index_.fetch_add(1);
+    if (index > MAX_INDEX)
+        throw std::bad_alloc();
+    const auto l = locate(index);
+    std::atomic<Node*>& chunk = chunks_[l.first];
+    if (chunk.load(std::memory_order_acquire) == nullptr) {
+        Node* const c = new Node[uint64_t(1) << (l.first + FIRST_CHUNK_BITS)];
+        Node* expected = nullptr;
+        if (!chunk.compare_exchange_strong(expected, c))
+            delete[] c;
+    }
+    return value(static_cast<uint32_t>(index), 0);
+}
+
+template <typename Node>
+template <typename... Args>
+tagged_index_value<Node> slab<Node>::create(Args&&... args)
+{
+    const value v = acquire();
+    if (sizeof...(args) > 0) {
+        Node* const p = v;
+        p->~Node();
+        try {
+            new (p) Node(std::forward<Args>(args)...);
+        } catch (...) {
+            new (p) Node();
+            destroy(v);
+            throw;
+        }
+    }
+    return v;
+}
+
+template <typename Node>
+void slab<Node>::destroy(value const v) noexcept
+{
+    free_.push(v);
+}
+
+} // namespace impl
+
+template <typename Node>
+tagged_index_value<Node>::operator Node*() const
+{
+    return impl::slab<Node>::at(index());
+}
+
+} // namespace lf
+} // namespace mu
@@ -0,0 +1,305 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+#include <mu/lf/impl/node_value.h>
+#include <mu/lf/impl/stack.h>
+#include <mu/lf/links.h>
+#include <mu/lf/provision.h>
+#include <mu/optional.h>
+#include <mu/spinlock.h>
+
+namespace mu {
+namespace lf {
+
+/// A blocking, multi-producer multi-consumer, unbounded queue with separate
+/// head and tail locks, sharing the interface of \c mu::lf::queue.
+///
+/// Producers serialize only with producers and consumers only with consumers,
+/// so the queue is competitive with lock-free queues at low thread counts,
+/// and its FIFO spinlocks make the order in which contending threads proceed
+/// deterministic.  It's a realistic baseline for the lock-free containers, and
+/// an alternative where that determinism matters more than lock-freedom: a
+/// thread descheduled while holding a lock stalls the others of its kind.
+///
+/// Memory is allocated on construction to provide initial capacity, and nodes
+/// are recycled through a lock-free free list, as for \c mu::lf::queue.
+///
+/// Mutating methods provide the strong exception safety guarantee.  Raised
+/// exceptions are limited to memory allocation exceptions and those thrown by
+/// \c T's copy and move constructors and assignment operators.
+///
+/// \tparam T must be default constructable, assignable and copy constructable.
+/// \tparam Lock \c mu::ticket_spinlock, for few contending threads, or
+///         \c mu::mcs_spinlock, for many.  Any type with a \c guard holding
+///         the lock for its lifetime will do.
+/// \tparam Allocator Rebound to allocate the queue's nodes.  Must be safe for
+///         concurrent use and have raw pointers.
+///
+/// \internal The implementation is the two-lock queue of "Simple, Fast, and
+///           Practical Non-Blocking and Blocking Concurrent Queue Algorithms"
+///           by Michael and Scott.  A sentinel head node is used, so producers
+///           and consumers never modify the same node but its link, which is
+///           atomic.
+template <
+        typename T,
+        typename Lock = ticket_spinlock,
+        typename Allocator = std::allocator<T>>
+class two_lock_queue {
+private:
+    struct node;
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    using lock_type = Lock;
+
+    constexpr static const size_t DEFAULT_INITIAL_CAPACITY = 8192;
+
+    /// Construct with the specified initial capacity.
+    ///
+    /// \param initial_capacity the initial capacity in number of nodes.
+    /// \param a the allocator from which nodes are allocated.
+    two_lock_queue(size_t initial_capacity, const Allocator& a = Allocator());
+
+    /// Construct with the specified initial capacity, provisioned as \c p
+    /// specifies.
+    two_lock_queue(
+            size_t initial_capacity,
+            provision p,
+            const Allocator& a = Allocator());
+
+    /// Construct with the default initial capacity.
+    two_lock_queue();
+
+    /// Construct with the default initial capacity.
+    explicit two_lock_queue(const Allocator& a);
+
+    two_lock_queue(const two_lock_queue&) = delete;
+
+    /// \pre \c empty() is \c true
+    ~two_lock_queue();
+    two_lock_queue& operator=(const two_lock_queue&) = delete;
+
+    /// Remove the head of the queue.
+    ///
+    /// \return \c true iff a valid, T value was assigned to \c out.
+    bool pop(T& out);
+
+    /// Remove the head of the queue.
+    ///
+    /// \return a valid, T value, or \c false.
+    optional<T> pop();
+
+    /// Move a value onto the queue.
+    void emplace(T&& e);
+
+    /// Copy a value onto the queue.
+    void push(const T& e);
+
+    /// \return \c true iff the queue has no nodes available for dequeueing.
+    bool empty() const;
+
+    size_t capacity() const { return capacity_; }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(pool_.get_allocator());
+    }
+
+private:
+    constexpr static const size_t CACHE_LINE_SIZE = 64;
+
+    using link = pointer_links::link<node>;
+    using link_value = typename link::value;
+
+    struct alignas(impl::node_alignment<
+            pointer_links, link, impl::node_value<T>>()) node {
+        node() : next_(nullptr) {}
+        impl::node_value<T> value_;
+        link next_;
+    };
+
+    using node_allocator = typename std::allocator_traits<Allocator>::
+            template rebind_alloc<node>;
+
+    void destroy() noexcept;        /// Free all instance resources.
+    void provide(size_t);           /// Allocate nodes onto the free list.
+    link_value alloc_node();        /// Return a free or new node.
+    void enqueue(link_value);
+
+    impl::node_pool<node, node_allocator, pointer_links> pool_;
+    std::atomic<size_t> capacity_;  /// Total capacity, free + used nodes.
+    std::atomic<size_t> reserve_;   /// Capacity yet to be provisioned.
+    impl::stack<node, link> free_;  /// Free node list.
+
+    mutable Lock head_lock_;
+    node* head_;                    /// Sentinel.  head_->next_ points to first.
+
+    /// Keeps the consumers' and producers' state on separate cache lines,
+    /// without over-aligning the queue, which \c new needn't honour.
+    char padding_[CACHE_LINE_SIZE];
+
+    Lock tail_lock_;
+    node* tail_;                    /// Tail, the sentinel if empty.
+};
+
+template <typename T, typename Lock, typename Allocator>
+void two_lock_queue<T, Lock, Allocator>::destroy() noexcept
+{
+    link_value n;
+    while (free_.pop(n)) {
+        pool_.destroy(n);
+    }
+    if (head_)
+        pool_.destroy(link_value(head_));
+}
+
+template <typename T, typename Lock, typename Allocator>
+two_lock_queue<T, Lock, Allocator>::two_lock_queue(
+        size_t const initial_capacity,
+        const Allocator& a) :
+        two_lock_queue(initial_capacity, provision::eager, a)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+two_lock_queue<T, Lock, Allocator>::two_lock_queue(
+        size_t const initial_capacity,
+        provision const p,
+        const Allocator& a) :
+        pool_(node_allocator(a)),
+        capacity_(initial_capacity),
+        reserve_(0),
+        head_(nullptr),
+        tail_(nullptr)
+{
+    try {
+        impl::provision_nodes(p, initial_capacity, reserve_,
+                [this](size_t count) { provide(count); });
+        head_ = tail_ = alloc_node();
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+template <typename T, typename Lock, typename Allocator>
+two_lock_queue<T, Lock, Allocator>::two_lock_queue() :
+        two_lock_queue(DEFAULT_INITIAL_CAPACITY)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+two_lock_queue<T, Lock, Allocator>::two_lock_queue(const Allocator& a) :
+        two_lock_queue(DEFAULT_INITIAL_CAPACITY, a)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+two_lock_queue<T, Lock, Allocator>::~two_lock_queue()
+{
+    assert(empty());
+    destroy();
+}
+
+template <typename T, typename Lock, typename Allocator>
+void two_lock_queue<T, Lock, Allocator>::provide(size_t const count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        free_.push(pool_.create());
+    }
+}
+
+template <typename T, typename Lock, typename Allocator>
+typename two_lock_queue<T, Lock, Allocator>::link_value
+two_lock_queue<T, Lock, Allocator>::alloc_node()
+{
+    link_value n;
+    while (!free_.pop(n)) {
+        // Provision a batch of any reserved capacity, else grow.
+        const size_t reserved = impl::claim(reserve_, impl::LAZY_BATCH);
+        if (reserved == 0) {
+            n = pool_.create();
+            ++capacity_;
+            break;
+        }
+        provide(reserved);
+    }
+    n->next_ = nullptr;
+    return n;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void two_lock_queue<T, Lock, Allocator>::push(T const& value)
+{
+    link_value n = alloc_node();
+    n->value_.store(value, [&] { free_.push(n); });
+    enqueue(n);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void two_lock_queue<T, Lock, Allocator>::emplace(T&& value)
+{
+    link_value n = alloc_node();
+    n->value_.store(std::move(value), [&] { free_.push(n); });
+    enqueue(n);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void two_lock_queue<T, Lock, Allocator>::enqueue(link_value const n)
+{
+    typename Lock::guard _(tail_lock_);
+    tail_->next_ = n;
+    tail_ = n;
+}
+
+template <typename T, typename Lock, typename Allocator>
+bool two_lock_queue<T, Lock, Allocator>::pop(T& out)
+{
+    node* old;
+    {
+        typename Lock::guard _(head_lock_);
+        node* const first = head_->next_;
+        if (first == nullptr)
+            return false;
+
+        // If T's copy assignment operator throws, the queue is unchanged.
+        out = first->value_.get();
+
+        // The first node becomes the sentinel.
+        first->value_.reset();
+        old = head_;
+        head_ = first;
+    }
+    free_.push(link_value(old));
+    return true;
+}
+
+template <typename T, typename Lock, typename Allocator>
+optional<T> two_lock_queue<T, Lock, Allocator>::pop()
+{
+    using std::experimental::make_optional;
+    using std::move;
+
+    T value;
+    if (pop(value))
+        return make_optional<T>(move(value));
+    return optional<T>();
+}
+
+template <typename T, typename Lock, typename Allocator>
+bool two_lock_queue<T, Lock, Allocator>::empty() const
+{
+    typename Lock::guard _(head_lock_);
+    return !head_->next_;
+}
+
+} // namespace lf
+} // namespace mu
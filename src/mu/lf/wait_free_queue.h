@@ -0,0 +1,721 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <mu/lf/impl/node_value.h>
+#include <mu/lf/impl/thread_slot.h>
+#include <mu/lf/links.h>
+#include <mu/lf/provision.h>
+#include <mu/lf/stack.h>
+#include <mu/lf/stats.h>
+#include <mu/optional.h>
+#include <mu/packed_atomic.h>
+
+namespace mu {
+namespace lf {
+
+/// A wait-free, multi-producer multi-consumer, unbounded queue, sharing the
+/// interface of \c mu::lf::queue.
+///
+/// Every operation completes in a bounded number of its own steps, however
+/// other threads are scheduled, where \c mu::lf::queue only guarantees some
+/// operation completes, so an unlucky thread may retry without bound.  An
+/// operation first tries the lock-free algorithm a few times, the fast path.
+/// Failing that, it announces itself and threads help complete announced
+/// operations in the order announced, the slow path.  Fast path operations
+/// also check an announcement every few operations, so the slow path can't
+/// be starved by them.  Operations take O(\c MAX_FAILURES + n^2) steps for
+/// n threads, but for allocating nodes, which is lock-free.
+///
+/// Memory is allocated on construction to provide initial capacity, as for
+/// \c mu::lf::queue.  Nodes are linked by \c mu::lf::index_links, so that an
+/// announcement fits in a single word.  Threads are identified by
+/// \c mu::lf::impl::thread_slot(), at most \c impl::thread_slots::MAX_SLOTS
+/// at once, and each has an announcement and fast path helping state, each
+/// on its own cache line, allocated on construction.
+///
+/// Pushes provide the strong exception safety guarantee.  Pops move the
+/// element out, after its removal, so if \c T's move assignment operator
+/// throws the element is lost.  Raised exceptions are limited to memory
+/// allocation exceptions, those thrown by \c T's copy and move constructors
+/// and assignment operators, and \c std::length_error should threads exhaust
+/// the slots.
+///
+/// \tparam T must be default constructable, assignable and copy constructable.
+/// \tparam Allocator Rebound to allocate the announcements and the free list.
+///         Nodes are allocated from the slab shared by queues of \c T.
+/// \tparam MaxFailures Lock-free attempts of an operation before announcing
+///         it, zero announcing every operation.
+///
+/// \internal The implementation is based on "Wait-Free Queues With Multiple
+///           Enqueuers and Dequeuers" by Kogan and Petrank, with the fast path
+///           of their "A Methodology for Creating Fast Wait-Free Data
+///           Structures", the Michael and Scott queue.  Announcements are
+///           packed (node, phase, pending, enqueue) descriptors, rather than
+///           pointers to immutable ones.  Garbage collection is replaced by
+///           tags on the links, incarnations on nodes' dequeuer claims, so
+///           that stale claims fail, and reference counts releasing a node
+///           once it's both unlinked from the head and its value taken.
+template <
+        typename T,
+        typename Allocator = std::allocator<T>,
+        unsigned MaxFailures = 8>
+class wait_free_queue {
+private:
+    struct node;
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+
+    constexpr static const size_t DEFAULT_INITIAL_CAPACITY = 8192;
+
+    constexpr static const unsigned MAX_FAILURES = MaxFailures;
+
+    /// Fast path operations by a thread between helping an announcement.
+    constexpr static const unsigned HELPING_DELAY = 16;
+
+    /// Construct with the specified initial capacity.
+    ///
+    /// \param initial_capacity the initial capacity in number of nodes.
+    /// \param a the allocator from which announcements are allocated.
+    wait_free_queue(size_t initial_capacity, const Allocator& a = Allocator());
+
+    /// Construct with the specified initial capacity, provisioned as \c p
+    /// specifies.
+    wait_free_queue(
+            size_t initial_capacity,
+            provision p,
+            const Allocator& a = Allocator());
+
+    /// Construct with the default initial capacity.
+    wait_free_queue();
+
+    /// Construct with the default initial capacity.
+    explicit wait_free_queue(const Allocator& a);
+
+    wait_free_queue(const wait_free_queue&) = delete;
+
+    /// \pre \c empty() is \c true
+    ~wait_free_queue();
+    wait_free_queue& operator=(const wait_free_queue&) = delete;
+
+    /// Remove the head of the queue.
+    ///
+    /// \return \c true iff a valid, T value was assigned to \c out.
+    bool pop(T& out);
+
+    /// Remove the head of the queue.
+    ///
+    /// \return a valid, T value, or \c false.
+    optional<T> pop();
+
+    /// Move a value onto the queue.
+    void emplace(T&& e);
+
+    /// Copy a value onto the queue.
+    void push(const T& e);
+
+    /// \return \c true iff the queue has no nodes available for dequeueing.
+    bool empty() const;
+
+    size_t capacity() const { return capacity_; }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(pool_.get_allocator());
+    }
+
+private:
+    using link = index_links::link<node>;
+    using link_value = typename link::value;
+
+    /// A node's claim by a dequeuer: (incarnation, claimant).
+    using claim_atomic =
+            packed_atomic<field<uint32_t, 32>, field<uint32_t, 32>>;
+    using claim = typename claim_atomic::value;
+    constexpr static const size_t INCARNATION = 0;
+    constexpr static const size_t CLAIMANT = 1;
+
+    /// The claimant of a node dequeued by the fast path.  Slow path claimants
+    /// are slot + 1, leaving zero unclaimed.
+    constexpr static const uint32_t FAST_CLAIMANT = 0xffff'ffff;
+
+    struct node {
+        node() : next_(nullptr), enqueuer_(0), refs_(0) {}
+        impl::node_value<T> value_;
+        link next_;
+        std::atomic<uint32_t> enqueuer_;    /// Slow path slot + 1, else 0.
+        claim_atomic claim_;
+        std::atomic<uint32_t> refs_;        /// Unlinked and taken, to free.
+    };
+
+    /// An announced operation: (node, phase, pending, enqueue).
+    using desc_atomic = packed_atomic<
+            field<uint32_t, 32>,
+            field<uint32_t, 30>,
+            field<bool, 1>,
+            field<bool, 1>>;
+    using desc = typename desc_atomic::value;
+    constexpr static const size_t NODE = 0;
+    constexpr static const size_t PHASE = 1;
+    constexpr static const size_t PENDING = 2;
+    constexpr static const size_t ENQUEUE = 3;
+    constexpr static const uint32_t PHASE_MASK = (uint32_t(1) << 30) - 1;
+
+    constexpr static const size_t CACHE_LINE_SIZE = 64;
+
+    /// A thread slot's announcement, read by every helper.  Padded, rather
+    /// than over-aligned, which \c new needn't honour, so that announcements
+    /// are on separate cache lines.
+    struct record {
+        desc_atomic desc_;
+        char padding_[CACHE_LINE_SIZE - sizeof(desc_atomic)];
+    };
+
+    /// A thread slot's fast path helping state, accessed only by the slot's
+    /// thread, on every operation, so kept apart from the announcements and
+    /// padded as they are.
+    struct helping {
+        helping() : countdown_(HELPING_DELAY), next_(0) {}
+        size_t countdown_;      /// Fast path operations until helping.
+        size_t next_;           /// The slot to help next.
+        char padding_[CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+    };
+
+    using traits = std::allocator_traits<Allocator>;
+    using free_list = stack<
+            link_value,
+            typename traits::template rebind_alloc<link_value>>;
+    using records = std::vector<
+            record,
+            typename traits::template rebind_alloc<record>>;
+    using helpings = std::vector<
+            helping,
+            typename traits::template rebind_alloc<helping>>;
+
+    /// \return \c true iff phase \c a is no later than \c b, modulo wrapping.
+    static bool precedes(uint32_t a, uint32_t b)
+    {
+        return ((b - a) & PHASE_MASK) <= PHASE_MASK / 2;
+    }
+
+    /// \return \c true iff \c d is pending and announced by phase \c phase.
+    static bool pending(desc d, uint32_t phase)
+    {
+        return d.template get<PENDING>() &&
+                precedes(d.template get<PHASE>(), phase);
+    }
+
+    static bool same_node(link_value a, link_value b)
+    {
+        return a.index() == b.index();
+    }
+
+    void destroy() noexcept;            /// Free all instance resources.
+    void provide(size_t);               /// Allocate nodes onto the free list.
+    link_value alloc_node();            /// Return a free or new node.
+    void release(link_value) noexcept;  /// Free when unlinked and taken.
+    void enqueue(link_value, size_t slot) noexcept;
+    bool dequeue(T&, size_t slot);
+
+    /// Move the value after the dequeued \c first into \c out.
+    void take(link_value first, T& out);
+
+    uint32_t next_phase() { return phase_.fetch_add(1) & PHASE_MASK; }
+
+    /// Help a pending operation of \c slot's, if due.
+    void help_delayed(size_t slot);
+
+    /// Help all pending operations announced by \c phase.
+    void help(uint32_t phase);
+    void help_enqueue(size_t slot, uint32_t phase);
+    void help_dequeue(size_t slot, uint32_t phase);
+
+    /// Complete the enqueue of the node after the tail, moving the tail.
+    void help_finish_enqueue();
+
+    /// Complete the dequeue claiming the head, moving the head.
+    void help_finish_dequeue();
+
+    impl::node_pool<node, Allocator, index_links> pool_;
+    std::atomic<size_t> capacity_;  /// Total capacity, free + used nodes.
+    std::atomic<size_t> reserve_;   /// Capacity yet to be provisioned.
+    std::atomic<uint32_t> phase_;   /// The next announcement's phase.
+    link head_;                     /// Sentinel.  head_->next_ points to first.
+    link tail_;                     /// Tail.  Points head_->next_ if empty.
+    free_list free_;                /// Free node list.
+    records records_;               /// Announcements, by thread slot.
+    helpings helping_;              /// Helping state, by thread slot.
+};
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::destroy() noexcept
+{
+    link_value n;
+    while (free_.pop(n)) {
+        pool_.destroy(n);
+    }
+    for (link_value i = head_.load(); i; i = n) {
+        n = i->next_.load();
+        pool_.destroy(i);
+    }
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+wait_free_queue<T, Allocator, MaxFailures>::wait_free_queue(
+        size_t const initial_capacity,
+        const Allocator& a) :
+        wait_free_queue(initial_capacity, provision::eager, a)
+{
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+wait_free_queue<T, Allocator, MaxFailures>::wait_free_queue(
+        size_t const initial_capacity,
+        provision const p,
+        const Allocator& a) :
+        pool_(a),
+        capacity_(initial_capacity),
+        reserve_(0),
+        phase_(0),
+        head_(),
+        tail_(),
+        free_(free_list::DEFAULT_INITIAL_CAPACITY,
+                p == provision::lazy ? provision::lazy : provision::eager,
+                a),
+        records_(impl::thread_slots::MAX_SLOTS, a),
+        helping_(impl::thread_slots::MAX_SLOTS, a)
+{
+    try {
+        impl::provision_nodes(p, initial_capacity, reserve_,
+                [this](size_t count) { provide(count); });
+        link_value n(alloc_node());
+        // The sentinel's value is never taken.
+        n->refs_.store(1);
+        head_ = n;
+        tail_ = n;
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+wait_free_queue<T, Allocator, MaxFailures>::wait_free_queue() :
+        wait_free_queue(DEFAULT_INITIAL_CAPACITY)
+{
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+wait_free_queue<T, Allocator, MaxFailures>::wait_free_queue(
+        const Allocator& a) :
+        wait_free_queue(DEFAULT_INITIAL_CAPACITY, a)
+{
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+wait_free_queue<T, Allocator, MaxFailures>::~wait_free_queue()
+{
+    assert(empty());
+    destroy();
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::provide(size_t const count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        link_value n(pool_.create());
+        try {
+            free_.push(n);
+        } catch (...) {
+            pool_.destroy(n);
+            throw;
+        }
+    }
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+typename wait_free_queue<T, Allocator, MaxFailures>::link_value
+wait_free_queue<T, Allocator, MaxFailures>::alloc_node()
+{
+    link_value n;
+    while (!free_.pop(n)) {
+        // Provision a batch of any reserved capacity, else grow.
+        const size_t reserved = impl::claim(reserve_, impl::LAZY_BATCH);
+        if (reserved == 0) {
+            n = pool_.create();
+            ++capacity_;
+            break;
+        }
+        provide(reserved);
+    }
+
+    // Start a new incarnation, so that stale compare and sets on the node
+    // fail.  Linking the node publishes the relaxed stores.
+    using std::memory_order_relaxed;
+    n->next_ = link_value(0, n->next_.load().get_tag() + 1);
+    const claim c = n->claim_.load(memory_order_relaxed);
+    n->claim_.store(claim(c.template get<INCARNATION>() + 1, 0),
+            memory_order_relaxed);
+    n->enqueuer_.store(0, memory_order_relaxed);
+    n->refs_.store(2, memory_order_relaxed);
+    return n;
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::release(
+        link_value const n) noexcept
+{
+    if (n->refs_.fetch_sub(1) == 1)
+        free_.push(n);
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::push(T const& value)
+{
+    const size_t slot = impl::thread_slot();
+    link_value n = alloc_node();
+    n->value_.store(value, [&] { free_.push(n); });
+    enqueue(n, slot);
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::emplace(T&& value)
+{
+    const size_t slot = impl::thread_slot();
+    link_value n = alloc_node();
+    n->value_.store(std::move(value), [&] { free_.push(n); });
+    enqueue(n, slot);
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::enqueue(
+        link_value const n,
+        size_t const slot) noexcept
+{
+    help_delayed(slot);
+
+    // The fast path, as mu::lf::queue.
+    for (unsigned i = 0; i < MAX_FAILURES; ++i) {
+        const link_value tail = tail_.load();
+        const link_value next = tail->next_.load();
+
+        // Verify read of tail_ and tail_->next_ is consistent.
+        if (tail != tail_.load()) {
+            impl::count_retry();
+            continue;
+        }
+
+        if (!next) {
+            // Attempt to link in the new node.
+            if (tail->next_.compare_set_strong(next,
+                    n.set_tag(next).increment_tag())) {
+                // If this update fails, another operation will update it.
+                tail_.compare_set_strong(tail, n.set_tag(tail).increment_tag());
+                return;
+            }
+        } else {
+            // The tail pointer has fallen behind, attempt to move it along.
+            help_finish_enqueue();
+        }
+        impl::count_retry();
+    }
+
+    // The slow path, announcing the enqueue for help.
+    n->enqueuer_.store(static_cast<uint32_t>(slot + 1),
+            std::memory_order_relaxed);
+    const uint32_t phase = next_phase();
+    records_[slot].desc_.store(desc(n.index(), phase, true, true));
+    help(phase);
+    help_finish_enqueue();
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+bool wait_free_queue<T, Allocator, MaxFailures>::pop(T& out)
+{
+    return dequeue(out, impl::thread_slot());
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+optional<T> wait_free_queue<T, Allocator, MaxFailures>::pop()
+{
+    using std::experimental::make_optional;
+    using std::move;
+
+    T value;
+    if (pop(value))
+        return make_optional<T>(move(value));
+    return optional<T>();
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+bool wait_free_queue<T, Allocator, MaxFailures>::dequeue(
+        T& value,
+        size_t const slot)
+{
+    help_delayed(slot);
+
+    // The fast path, claiming the head then moving it along.
+    for (unsigned i = 0; i < MAX_FAILURES; ++i) {
+        // Read the state in an order allowing consistency verification.
+        const link_value first = head_.load();
+        const link_value last = tail_.load();
+        const link_value next = first->next_.load();
+        claim c = first->claim_.load();
+
+        // Verify read of head_, tail_, head_->next_ and its claim is
+        // consistent.
+        if (first != head_.load()) {
+            impl::count_retry();
+            continue;
+        }
+
+        if (same_node(first, last)) {
+            if (!next) {
+                // The queue is empty.
+                return false;
+            }
+            // The tail pointer has fallen behind, attempt to move it along.
+            help_finish_enqueue();
+        } else if (c.template get<CLAIMANT>() != 0) {
+            // Another dequeue claimed the head, help it complete.
+            help_finish_dequeue();
+        } else if (first->claim_.compare_exchange_strong(c,
+                c.template set<CLAIMANT>(FAST_CLAIMANT))) {
+            help_finish_dequeue();
+            take(first, value);
+            return true;
+        }
+        impl::count_retry();
+    }
+
+    // The slow path, announcing the dequeue for help.
+    const uint32_t phase = next_phase();
+    records_[slot].desc_.store(desc(0, phase, true, false));
+    help(phase);
+    help_finish_dequeue();
+
+    const desc d = records_[slot].desc_.load();
+    if (d.template get<NODE>() == 0)
+        return false;
+    take(link_value(d.template get<NODE>(), 0), value);
+    return true;
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::take(
+        link_value const first,
+        T& out)
+{
+    // The claimant holds first, the new head's predecessor, and next, whose
+    // value only it reads, until released.
+    const link_value next = first->next_.load();
+    try {
+        out = std::move(next->value_.get());
+    } catch (...) {
+        next->value_.reset();
+        release(next);
+        release(first);
+        throw;
+    }
+    next->value_.reset();
+    release(next);
+    release(first);
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::help_delayed(size_t const slot)
+{
+    helping& h = helping_[slot];
+    if (--h.countdown_ != 0)
+        return;
+    h.countdown_ = HELPING_DELAY;
+
+    // Check each slot in turn.
+    const size_t helped = h.next_;
+    h.next_ = helped + 1 < impl::thread_slots::instance().high_water() ?
+            helped + 1 : 0;
+    const desc d = records_[helped].desc_.load();
+    if (!d.template get<PENDING>())
+        return;
+    if (d.template get<ENQUEUE>())
+        help_enqueue(helped, d.template get<PHASE>());
+    else
+        help_dequeue(helped, d.template get<PHASE>());
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::help(uint32_t const phase)
+{
+    const size_t slots = impl::thread_slots::instance().high_water();
+    for (size_t i = 0; i < slots; ++i) {
+        const desc d = records_[i].desc_.load();
+        if (!pending(d, phase))
+            continue;
+        if (d.template get<ENQUEUE>())
+            help_enqueue(i, phase);
+        else
+            help_dequeue(i, phase);
+    }
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::help_enqueue(
+        size_t const slot,
+        uint32_t const phase)
+{
+    desc_atomic& announced = records_[slot].desc_;
+    while (pending(announced.load(), phase)) {
+        const link_value last = tail_.load();
+        const link_value next = last->next_.load();
+
+        // Verify read of tail_ and tail_->next_ is consistent.
+        if (last != tail_.load()) {
+            impl::count_retry();
+            continue;
+        }
+
+        if (next) {
+            // Complete the enqueue in progress.
+            help_finish_enqueue();
+            continue;
+        }
+
+        // Link in the announced node, read with its pending state, as once
+        // enqueued it may be linked after the tail already.
+        const desc d = announced.load();
+        if (pending(d, phase) && last->next_.compare_set_strong(next,
+                link_value(d.template get<NODE>(), next.get_tag() + 1))) {
+            help_finish_enqueue();
+            return;
+        }
+        impl::count_retry();
+    }
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::help_finish_enqueue()
+{
+    const link_value last = tail_.load();
+    const link_value next = last->next_.load();
+    if (!next)
+        return;
+
+    // Mark a slow path enqueue complete before the tail moves past its node.
+    const uint32_t enqueuer = next->enqueuer_.load();
+    if (enqueuer != 0) {
+        desc_atomic& announced = records_[enqueuer - 1].desc_;
+        desc d = announced.load();
+        if (last == tail_.load() && d.template get<NODE>() == next.index())
+            announced.compare_exchange_strong(d,
+                    d.template set<PENDING>(false));
+    }
+    tail_.compare_set_strong(last, next.set_tag(last).increment_tag());
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::help_dequeue(
+        size_t const slot,
+        uint32_t const phase)
+{
+    desc_atomic& announced = records_[slot].desc_;
+    while (pending(announced.load(), phase)) {
+        // Read the state in an order allowing consistency verification.
+        const link_value first = head_.load();
+        const link_value last = tail_.load();
+        const link_value next = first->next_.load();
+        claim c = first->claim_.load();
+
+        // Verify read of head_, tail_, head_->next_ and its claim is
+        // consistent.
+        if (first != head_.load()) {
+            impl::count_retry();
+            continue;
+        }
+
+        if (same_node(first, last)) {
+            if (!next) {
+                // The queue is empty, complete the dequeue without a node.
+                desc d = announced.load();
+                if (last == tail_.load() && pending(d, phase))
+                    announced.compare_exchange_strong(d,
+                            desc(0, d.template get<PHASE>(), false, false));
+            } else {
+                // The tail pointer has fallen behind, move it along.
+                help_finish_enqueue();
+            }
+            continue;
+        }
+
+        // Announce the head as the node to dequeue, then claim it.
+        desc d = announced.load();
+        if (!pending(d, phase))
+            break;
+        if (first == head_.load() && d.template get<NODE>() != first.index()) {
+            if (!announced.compare_exchange_strong(d,
+                    d.template set<NODE>(first.index()))) {
+                impl::count_retry();
+                continue;
+            }
+        }
+        if (c.template get<CLAIMANT>() == 0)
+            first->claim_.compare_exchange_strong(c,
+                    c.template set<CLAIMANT>(static_cast<uint32_t>(slot + 1)));
+        help_finish_dequeue();
+    }
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+void wait_free_queue<T, Allocator, MaxFailures>::help_finish_dequeue()
+{
+    const link_value first = head_.load();
+    const link_value next = first->next_.load();
+    const uint32_t claimant =
+            first->claim_.load().template get<CLAIMANT>();
+    if (claimant == 0)
+        return;
+
+    // Mark a slow path dequeue complete before the head moves past its node.
+    desc d;
+    desc_atomic* const announced = claimant == FAST_CLAIMANT ? nullptr :
+            &records_[claimant - 1].desc_;
+    if (announced)
+        d = announced->load();
+    if (first != head_.load() || !next)
+        return;
+    if (announced)
+        announced->compare_exchange_strong(d, d.template set<PENDING>(false));
+    head_.compare_set_strong(first, next.set_tag(first).increment_tag());
+}
+
+template <typename T, typename Allocator, unsigned MaxFailures>
+bool wait_free_queue<T, Allocator, MaxFailures>::empty() const
+{
+    while (true) {
+        const link_value first = head_.load();
+        const link_value next = first->next_.load();
+        const claim c = first->claim_.load();
+        if (!next && first == head_.load())
+            return true;
+        if (c.template get<CLAIMANT>() == 0 && first == head_.load())
+            return false;
+
+        // The first value is taken, but the head is yet to move past it.
+        const bool last = next && !next->next_.load();
+        if (first == head_.load())
+            return last;
+    }
+}
+
+} // namespace lf
+} // namespace mu
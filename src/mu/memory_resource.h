@@ -0,0 +1,28 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+// Prefer the standard polymorphic memory resources, which include the pool and
+// monotonic buffer resources, falling back to the library fundamentals TS.
+#if defined(__has_include)
+#if __cplusplus > 201402L && __has_include(<memory_resource>)
+#define MU_STD_PMR 1
+#endif
+#endif
+
+#if defined(MU_STD_PMR)
+#include <memory_resource>
+#else
+#include <experimental/memory_resource>
+#endif
+
+namespace mu {
+    /// Convenience alias for the polymorphic memory resource namespace, e.g.
+    /// \c mu::pmr::memory_resource and \c mu::pmr::polymorphic_allocator.
+#if defined(MU_STD_PMR)
+    namespace pmr = std::pmr;
+#else
+    namespace pmr = std::experimental::pmr;
+#endif
+} // namespace mu
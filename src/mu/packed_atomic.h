@@ -0,0 +1,274 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+namespace mu {
+
+/// A field of \c Bits bits holding values of type \c T, for \c packed and \c
+/// packed_atomic.
+///
+/// \tparam T An unsigned integral, \c bool, enumeration or pointer type.
+///         Pointers must have no significant bits above \c Bits, e.g. 48 for
+///         x86_64 user space addresses.
+template <typename T, unsigned Bits>
+struct field {
+    static_assert(std::is_unsigned<T>::value || std::is_enum<T>::value ||
+            std::is_pointer<T>::value, "unsupported field type");
+    static_assert(Bits > 0 && Bits <= 64, "field must be 1 to 64 bits");
+
+    using type = T;
+    constexpr static const unsigned bits = Bits;
+    constexpr static const uint64_t mask =
+            Bits == 64 ? ~uint64_t(0) : (uint64_t(1) << Bits) - 1;
+};
+
+namespace impl {
+
+/// The offset of field \c I, fields being laid out from the least significant
+/// bit in order.
+template <size_t I, typename... Fields>
+struct field_offset;
+
+template <typename F, typename... Fields>
+struct field_offset<0, F, Fields...> :
+        std::integral_constant<unsigned, 0> {};
+
+template <size_t I, typename F, typename... Fields>
+struct field_offset<I, F, Fields...> :
+        std::integral_constant<unsigned,
+                F::bits + field_offset<I - 1, Fields...>::value> {};
+
+/// The total width of the fields.
+template <typename... Fields>
+struct fields_width : std::integral_constant<unsigned, 0> {};
+
+template <typename F, typename... Fields>
+struct fields_width<F, Fields...> :
+        std::integral_constant<unsigned,
+                F::bits + fields_width<Fields...>::value> {};
+
+/// Conversions of field values to and from their bits.  Those of pointers
+/// aren't constant expressions.
+template <typename T>
+constexpr typename std::enable_if<!std::is_pointer<T>::value, uint64_t>::type
+to_bits(T v)
+{
+    return static_cast<uint64_t>(v);
+}
+
+template <typename T>
+typename std::enable_if<std::is_pointer<T>::value, uint64_t>::type
+to_bits(T v)
+{
+    return reinterpret_cast<uintptr_t>(v);
+}
+
+template <typename T>
+constexpr typename std::enable_if<!std::is_pointer<T>::value, T>::type
+from_bits(uint64_t b)
+{
+    return static_cast<T>(b);
+}
+
+template <typename T>
+typename std::enable_if<std::is_pointer<T>::value, T>::type
+from_bits(uint64_t b)
+{
+    return reinterpret_cast<T>(static_cast<uintptr_t>(b));
+}
+
+} // namespace impl
+
+/// A value of \c Fields packed into 64 bits, the first field in the least
+/// significant bits.
+///
+/// Values are truncated to the width of their field when set, so counters,
+/// e.g. ABA tags, wrap.  Accessors are constant expressions, but for pointer
+/// fields.
+///
+/// \tparam Fields \c mu::field types totalling at most 64 bits.
+template <typename... Fields>
+class packed {
+public:
+    static_assert(sizeof...(Fields) > 0, "no fields");
+    static_assert(impl::fields_width<Fields...>::value <= 64,
+            "fields exceed 64 bits");
+
+    /// The type of field \c I.
+    template <size_t I>
+    using type = typename std::tuple_element<
+            I, std::tuple<typename Fields::type...>>::type;
+
+    /// All fields zero.
+    constexpr packed() : bits_(0) {}
+
+    /// Each field set to the corresponding value.
+    constexpr explicit packed(typename Fields::type... values) :
+            bits_(pack<0>(values...))
+    {
+    }
+
+    /// \return the instance with representation \c bits.
+    constexpr static packed from_bits(uint64_t bits)
+    {
+        return packed(raw(), bits);
+    }
+
+    /// \return the value of field \c I.
+    template <size_t I>
+    constexpr type<I> get() const
+    {
+        return impl::from_bits<type<I>>((bits_ >> offset<I>()) & mask<I>());
+    }
+
+    /// \return a copy with field \c I set to \c v.
+    template <size_t I>
+    constexpr packed set(type<I> v) const
+    {
+        return packed(raw(), (bits_ & ~(mask<I>() << offset<I>())) |
+                ((impl::to_bits(v) & mask<I>()) << offset<I>()));
+    }
+
+    /// \return the representation.
+    constexpr uint64_t bits() const { return bits_; }
+
+    constexpr bool operator==(const packed& o) const
+    {
+        return bits_ == o.bits_;
+    }
+
+    constexpr bool operator!=(const packed& o) const
+    {
+        return bits_ != o.bits_;
+    }
+
+private:
+    /// Selects construction from the representation.
+    struct raw {};
+
+    constexpr packed(raw, uint64_t bits) : bits_(bits) {}
+
+    template <size_t I>
+    constexpr static unsigned offset()
+    {
+        return impl::field_offset<I, Fields...>::value;
+    }
+
+    template <size_t I>
+    constexpr static uint64_t mask()
+    {
+        return std::tuple_element<I, std::tuple<Fields...>>::type::mask;
+    }
+
+    template <size_t I>
+    constexpr static uint64_t pack() { return 0; }
+
+    template <size_t I, typename V, typename... Vs>
+    constexpr static uint64_t pack(V v, Vs... vs)
+    {
+        return ((impl::to_bits(v) & mask<I>()) << offset<I>()) |
+                pack<I + 1>(vs...);
+    }
+
+    uint64_t bits_;
+};
+
+/// An atomic \c packed value, updated by compare and set of a single 64-bit
+/// word, so lock-free wherever \c std::atomic<uint64_t> is.
+///
+/// \tparam Fields \c mu::field types totalling at most 64 bits.
+template <typename... Fields>
+class packed_atomic {
+public:
+    using value = packed<Fields...>;
+
+    packed_atomic() : bits_(0) {}
+    explicit packed_atomic(value v) : bits_(v.bits()) {}
+    packed_atomic(const packed_atomic&) = delete;
+    packed_atomic& operator=(const packed_atomic&) = delete;
+
+    ///\return \c true iff the atomic operations on instances are lock free.
+    bool is_lock_free() const { return bits_.is_lock_free(); }
+
+    value load(std::memory_order m = std::memory_order_seq_cst) const
+    {
+        return value::from_bits(bits_.load(m));
+    }
+
+    void store(value v, std::memory_order m = std::memory_order_seq_cst)
+    {
+        bits_.store(v.bits(), m);
+    }
+
+    /// Atomically compare \c this with \c expected and iff equal set former to
+    /// latter, else load the current value into \c expected.
+    ///
+    /// \return \c true iff \c this was set to \c desired.
+    bool compare_exchange_strong(
+            value& expected,
+            value desired,
+            std::memory_order m = std::memory_order_seq_cst);
+
+    /// As \c compare_exchange_strong(), but may fail spuriously.
+    bool compare_exchange_weak(
+            value& expected,
+            value desired,
+            std::memory_order m = std::memory_order_seq_cst);
+
+    /// Atomically replace the value \c v with \c f(v), retrying until no other
+    /// update intervenes.
+    ///
+    /// \param f Invoked as \c f(value), perhaps repeatedly, returning the
+    ///        replacement.
+    /// \return the value replaced.
+    template <typename F>
+    value fetch_update(F f, std::memory_order m = std::memory_order_seq_cst);
+
+private:
+    std::atomic<uint64_t> bits_;
+};
+
+template <typename... Fields>
+bool packed_atomic<Fields...>::compare_exchange_strong(
+        value& expected,
+        const value desired,
+        const std::memory_order m)
+{
+    uint64_t e = expected.bits();
+    const bool set = bits_.compare_exchange_strong(e, desired.bits(), m);
+    expected = value::from_bits(e);
+    return set;
+}
+
+template <typename... Fields>
+bool packed_atomic<Fields...>::compare_exchange_weak(
+        value& expected,
+        const value desired,
+        const std::memory_order m)
+{
+    uint64_t e = expected.bits();
+    const bool set = bits_.compare_exchange_weak(e, desired.bits(), m);
+    expected = value::from_bits(e);
+    return set;
+}
+
+template <typename... Fields>
+template <typename F>
+typename packed_atomic<Fields...>::value packed_atomic<Fields...>::fetch_update(
+        F f,
+        const std::memory_order m)
+{
+    value v = load(std::memory_order_relaxed);
+    while (!compare_exchange_weak(v, f(v), m)) {
+    }
+    return v;
+}
+
+} // namespace mu
@@ -0,0 +1,158 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace mu {
+
+namespace impl {
+
+/// Spins before yielding the CPU while waiting for a lock.
+constexpr static const unsigned SPINS_BEFORE_YIELD = 64;
+
+/// Wait once, in a loop polling for a lock.
+///
+/// Hints to the CPU that the caller is spinning, e.g. on x86 to yield pipeline
+/// resources to a sibling hyperthread and avoid the memory order violation
+/// flush on leaving the loop.  Every \c SPINS_BEFORE_YIELD spins the thread
+/// yields, as the FIFO locks can only be passed to the thread whose turn it
+/// is, which when threads outnumber CPUs may not be running.
+///
+/// \param spins The calling loop's count of spins, incremented.
+inline void spin_wait(unsigned& spins)
+{
+    if (++spins % SPINS_BEFORE_YIELD == 0) {
+        std::this_thread::yield();
+        return;
+    }
+#if defined(__amd64__) || defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+} // namespace impl
+
+/// A FIFO spinlock granting the lock in ticket order, so no waiter starves.
+///
+/// Waiters all spin on the one word, each release invalidating every
+/// waiter's cache line, which suits short critical sections with few
+/// contending threads.
+class ticket_spinlock {
+public:
+    ticket_spinlock() : next_(0), serving_(0) {}
+    ticket_spinlock(const ticket_spinlock&) = delete;
+    ticket_spinlock& operator=(const ticket_spinlock&) = delete;
+
+    void lock()
+    {
+        const uint32_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        unsigned spins = 0;
+        while (serving_.load(std::memory_order_acquire) != ticket) {
+            impl::spin_wait(spins);
+        }
+    }
+
+    void unlock()
+    {
+        serving_.store(serving_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    }
+
+    /// Holds the lock for its lifetime.
+    class guard {
+    public:
+        explicit guard(ticket_spinlock& l) : lock_(l) { lock_.lock(); }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard() { lock_.unlock(); }
+
+    private:
+        ticket_spinlock& lock_;
+    };
+
+private:
+    std::atomic<uint32_t> next_;       /// The next ticket to issue.
+    std::atomic<uint32_t> serving_;    /// The ticket holding the lock.
+};
+
+/// The queue lock of Mellor-Crummey and Scott, granting the lock in FIFO
+/// order.
+///
+/// Each waiter spins on a flag in its own queue node, so a release invalidates
+/// only the successor's cache line and the lock scales to many contending
+/// threads, at the cost of an extra compare and set to release when
+/// uncontended.  Nodes are provided by \c guard, on the locking thread's
+/// stack.
+class mcs_spinlock {
+public:
+    /// A waiter's place in the queue for the lock.
+    struct node {
+        std::atomic<node*> next_;
+        std::atomic<bool> locked_;
+    };
+
+    mcs_spinlock() : tail_(nullptr) {}
+    mcs_spinlock(const mcs_spinlock&) = delete;
+    mcs_spinlock& operator=(const mcs_spinlock&) = delete;
+
+    /// Acquire the lock, queueing \c n until released by the predecessor.
+    void lock(node& n);
+
+    /// Release the lock acquired with \c n to the successor, if any.
+    void unlock(node& n);
+
+    /// Holds the lock for its lifetime.
+    class guard {
+    public:
+        explicit guard(mcs_spinlock& l) : lock_(l) { lock_.lock(node_); }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard() { lock_.unlock(node_); }
+
+    private:
+        mcs_spinlock& lock_;
+        node node_;
+    };
+
+private:
+    std::atomic<node*> tail_;   /// The last waiter, or \c nullptr if free.
+};
+
+inline void mcs_spinlock::lock(node& n)
+{
+    n.next_.store(nullptr, std::memory_order_relaxed);
+    n.locked_.store(true, std::memory_order_relaxed);
+    node* const predecessor = tail_.exchange(&n, std::memory_order_acq_rel);
+    if (predecessor == nullptr)
+        return;
+
+    predecessor->next_.store(&n, std::memory_order_release);
+    unsigned spins = 0;
+    while (n.locked_.load(std::memory_order_acquire)) {
+        impl::spin_wait(spins);
+    }
+}
+
+inline void mcs_spinlock::unlock(node& n)
+{
+    node* successor = n.next_.load(std::memory_order_acquire);
+    if (successor == nullptr) {
+        // Free the lock unless a successor has queued but is yet to link in.
+        node* expected = &n;
+        if (tail_.compare_exchange_strong(expected, nullptr,
+                std::memory_order_release, std::memory_order_relaxed))
+            return;
+        unsigned spins = 0;
+        while ((successor = n.next_.load(std::memory_order_acquire)) ==
+                nullptr) {
+            impl::spin_wait(spins);
+        }
+    }
+    successor->locked_.store(false, std::memory_order_release);
+}
+
+} // namespace mu
@@ -4,45 +4,176 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace mu {
 
 /// Select implementation for architecture.
+///
+/// Tags occupy the pointer bits above the significant virtual address bits,
+/// and optionally the \c LowBits least significant bits, zero in pointers to
+/// objects aligned to \c 2^LowBits bytes.
 namespace arch {
 #if defined(__amd64__) || defined(__x86_64__) || defined(_M_AMD64)
-    constexpr static const size_t MAX_TAG = 0xffff;
-    constexpr static const uintptr_t MASK = 0xffff'0000'0000'0000;
+    constexpr static const unsigned POINTER_BITS = 64;
+    constexpr static const unsigned DEFAULT_ADDRESS_BITS = 48;
+    /// With 5-level paging.
+    constexpr static const unsigned MAX_ADDRESS_BITS = 57;
+    /// \return the low bits tagged by default.  None, as \c T may be
+    ///         unaligned and the high bits suffice.
+    template <typename T>
+    constexpr unsigned default_low_bits() { return 0; }
+    /// Low bits zero in pointers to pointer aligned objects.
+    constexpr static const unsigned POINTER_LOW_BITS = 3;
 #elif defined(__i386__) || defined(_M_IX86) || defined(i386)
-    constexpr static const size_t MAX_TAG = 0x03;
-    constexpr static const uintptr_t MASK = 0x03;
+    constexpr static const unsigned POINTER_BITS = 32;
+    constexpr static const unsigned DEFAULT_ADDRESS_BITS = 32;
+    constexpr static const unsigned MAX_ADDRESS_BITS = 32;
+    /// \return the low bits tagged by default, the only tag bits with 32-bit
+    ///         addresses: two, or as many as the alignment of \c T leaves
+    ///         zero.
+    template <typename T>
+    constexpr unsigned default_low_bits()
+    {
+        return alignof(T) >= 4 ? 2 : alignof(T) >= 2 ? 1 : 0;
+    }
+    constexpr static const unsigned POINTER_LOW_BITS = 2;
 #else
     static_assert(false, "unsupported platform");
 #endif
-    template<typename T> size_t tag(T*);
-    template<typename T> T* tag(T*, size_t);
-    template<typename T> T* untag(T*);
+
+    /// The significant virtual address bits and the pointer bits above them.
+    struct address_layout {
+        constexpr explicit address_layout(unsigned b) :
+                bits(b),
+                high_mask(b < POINTER_BITS ? ~uintptr_t(0) << b : 0)
+        {
+        }
+
+        unsigned bits;
+        uintptr_t high_mask;
+    };
+
+    /// \return the layout of user space addresses, 57-bit on x86_64 kernels
+    ///         with 5-level paging, else 48-bit, or 32-bit on i386.
+    const address_layout& addresses();
+
+    template <unsigned LowBits> struct layout;
 }
 
+template <typename T, unsigned LowBits> class tagged_ptr;
+
+/// A non-atomic snapshot of a \c tagged_ptr, for local variables.
+///
+/// Loading a \c tagged_ptr into a \c tagged_value once per iteration of a
+/// compare and set loop performs only the atomic loads the algorithm needs,
+/// where every operation on a local \c tagged_ptr is another atomic load.
+///
+/// \tparam T The type of the object instances point to.
+/// \tparam LowBits As for \c tagged_ptr.
+template <typename T, unsigned LowBits = arch::default_low_bits<T>()>
+class tagged_value {
+    using layout = arch::layout<LowBits>;
+
+public:
+    /// \return the largest tag value, after which tags wrap to zero.
+    static size_t max_tag() { return layout::max_tag(); }
+
+    tagged_value() : ptr_(nullptr) {}
+    explicit tagged_value(T* ptr) : ptr_(ptr) {}
+
+    /// \return a copy of this instance but with the tag set to \c o.get_tag().
+    tagged_value set_tag(const tagged_value& o) const
+    {
+        return tagged_value(layout::tag(ptr_, o.get_tag()));
+    }
+
+    /// \return a copy of this instance with the tag = tag + 1 mod
+    ///         max_tag() + 1.
+    tagged_value increment_tag() const
+    {
+        return tagged_value(layout::tag(ptr_, get_tag() + 1));
+    }
+
+    /// \return a copy of this instance with the tag = \c tag mod
+    ///         max_tag() + 1.
+    tagged_value with_tag(size_t tag) const
+    {
+        return tagged_value(layout::tag(ptr_, tag));
+    }
+
+    /// \return the value of the tag.
+    size_t get_tag() const { return layout::tag(ptr_); }
+
+    operator bool() const { return layout::untag(ptr_) != nullptr; }
+    operator T*() const { return layout::untag(ptr_); }
+    T& operator*() const { return *layout::untag(ptr_); }
+    T* operator->() const { return layout::untag(ptr_); }
+    bool operator==(const tagged_value& o) const { return ptr_ == o.ptr_; }
+    bool operator!=(const tagged_value& o) const { return ptr_ != o.ptr_; }
+
+private:
+    friend class tagged_ptr<T, LowBits>;
+
+    T* ptr_;        /// The tagged pointer.
+};
+
 /// A tagged pointer suitable for counting pointers for ABA protection.
 ///
 /// Methods are provided to manipulate the tag bits and atomically compare and
 /// set instance values.
 ///
+/// The tag is \c LowBits plus the bits above the significant address bits
+/// wide: on x86_64 16 + \c LowBits with 48-bit addresses, or 7 + \c LowBits
+/// on kernels with 5-level paging, where addresses may have 57 bits.  The
+/// layout is selected at run time so the tags of both fit a single word
+/// compare and set.
+///
 /// Platform support: x86_64 and i386
 ///
-/// \tparam The type of the object instances point to.
-template <typename T>
+/// \tparam T The type of the object instances point to.
+/// \tparam LowBits The number of least significant pointer bits to use for the
+///         tag, requiring instances to point to objects aligned to
+///         \c 2^LowBits bytes, e.g. with \c alignas.  By default none on
+///         x86_64, and on i386 as many as \c alignof(T) allows, up to two.
+template <typename T, unsigned LowBits = arch::default_low_bits<T>()>
 class tagged_ptr {
+    using layout = arch::layout<LowBits>;
+
 public:
-    constexpr static const size_t MAX_TAG = arch::MAX_TAG;
+    /// The snapshot type of \c load().
+    using value = tagged_value<T, LowBits>;
+
+    /// \return the largest tag value, after which tags wrap to zero.
+    static size_t max_tag() { return value::max_tag(); }
 
     tagged_ptr() : ptr_() { ptr_ = nullptr; }
-    explicit tagged_ptr(T* ptr) { ptr_ =  ptr; }
+    explicit tagged_ptr(T* ptr) { ptr_ = layout::check(ptr); }
+    explicit tagged_ptr(value v) { ptr_ = v.ptr_; }
     tagged_ptr(const tagged_ptr& o) { ptr_.store(o.ptr_); }
     tagged_ptr& operator=(const tagged_ptr&);
-    tagged_ptr& operator=(T* ptr) { ptr_.store(ptr); return *this; }
+    tagged_ptr& operator=(T* ptr)
+    {
+        ptr_.store(layout::check(ptr));
+        return *this;
+    }
+    tagged_ptr& operator=(value v)
+    {
+        ptr_.store(v.ptr_);
+        return *this;
+    }
     ~tagged_ptr() = default;
 
+    /// \return a snapshot of the pointer and tag, by a single atomic load.
+    value load() const { return value(ptr_.load()); }
+
     ///\return \c true iff the atomic operations on instances are lock free.
     bool is_lock_free() const { return ptr_.is_lock_free(); }
 
@@ -52,21 +183,31 @@ public:
     /// \return \c true iff \c this was set to \c desired.
     bool compare_set_strong(tagged_ptr expected, tagged_ptr desired);
 
+    /// Atomically compare \c this with \c expected and iff equal set former to
+    /// latter.
+    ///
+    /// \return \c true iff \c this was set to \c desired.
+    bool compare_set_strong(value expected, value desired)
+    {
+        return ptr_.compare_exchange_strong(expected.ptr_, desired.ptr_);
+    }
+
     /// \return a copy of this instance but with the tag set to \c o.get_tag().
     tagged_ptr set_tag(const tagged_ptr& o) const;
 
-    /// \return a copy of this instance with the tag = tag + 1 mod MAX_TAG.
+    /// \return a copy of this instance with the tag = tag + 1 mod
+    ///         max_tag() + 1.
     tagged_ptr increment_tag() const;
 
     /// \return the value of the tag.
     size_t get_tag() const;
 
-    operator bool() const { return arch::untag(ptr_.load()) != nullptr; }
-    operator T*() const { return arch::untag(ptr_.load()); }
-    T& operator*() { return *arch::untag(ptr_.load()); }
-    const T& operator*() const { return *arch::untag(ptr_.load()); }
-    T* operator->() { return arch::untag(ptr_.load()); }
-    T const * operator->() const { return arch::untag(ptr_.load()); }
+    operator bool() const { return layout::untag(ptr_.load()) != nullptr; }
+    operator T*() const { return layout::untag(ptr_.load()); }
+    T& operator*() { return *layout::untag(ptr_.load()); }
+    const T& operator*() const { return *layout::untag(ptr_.load()); }
+    T* operator->() { return layout::untag(ptr_.load()); }
+    T const * operator->() const { return layout::untag(ptr_.load()); }
     bool operator==(const tagged_ptr&) const;
     bool operator!=(const tagged_ptr&) const;
 
@@ -74,92 +215,152 @@ private:
     std::atomic<T*> ptr_;
 };
 
-template<typename T>
-bool tagged_ptr<T>::compare_set_strong(
-        tagged_ptr<T> expected,
-        tagged_ptr<T> desired)
+template <typename T, unsigned LowBits>
+bool tagged_ptr<T, LowBits>::compare_set_strong(
+        tagged_ptr<T, LowBits> expected,
+        tagged_ptr<T, LowBits> desired)
 {
     T* e = expected.ptr_.load();
     T* d = desired.ptr_.load();
     return ptr_.compare_exchange_strong(e, d);
 }
 
-template<typename T>
-tagged_ptr<T> tagged_ptr<T>::set_tag(const tagged_ptr<T>& o) const
+template <typename T, unsigned LowBits>
+tagged_ptr<T, LowBits> tagged_ptr<T, LowBits>::set_tag(
+        const tagged_ptr<T, LowBits>& o) const
 {
-    return tagged_ptr(arch::tag(ptr_.load(), o.get_tag()));
+    return tagged_ptr(value(layout::tag(ptr_.load(), o.get_tag())));
 }
 
-template<typename T>
-tagged_ptr<T> tagged_ptr<T>::increment_tag() const
+template <typename T, unsigned LowBits>
+tagged_ptr<T, LowBits> tagged_ptr<T, LowBits>::increment_tag() const
 {
-    return tagged_ptr(arch::tag(ptr_.load(), get_tag() + 1));
+    return tagged_ptr(value(layout::tag(ptr_.load(), get_tag() + 1)));
 }
 
-template<typename T>
-size_t tagged_ptr<T>::get_tag() const
+template <typename T, unsigned LowBits>
+size_t tagged_ptr<T, LowBits>::get_tag() const
 {
-    return arch::tag(ptr_.load());
+    return layout::tag(ptr_.load());
 }
 
-template<typename T>
-tagged_ptr<T>& tagged_ptr<T>::operator=(const tagged_ptr<T>& o)
+template <typename T, unsigned LowBits>
+tagged_ptr<T, LowBits>& tagged_ptr<T, LowBits>::operator=(
+        const tagged_ptr<T, LowBits>& o)
 {
     ptr_.store(o.ptr_);
     return *this;
 }
 
-template<typename T>
-bool tagged_ptr<T>::operator==(const tagged_ptr<T>& o) const
+template <typename T, unsigned LowBits>
+bool tagged_ptr<T, LowBits>::operator==(const tagged_ptr<T, LowBits>& o) const
 {
     return ptr_.load() == o.ptr_.load();
 }
 
-template<typename T>
-bool tagged_ptr<T>::operator!=(const tagged_ptr<T>& o) const
+template <typename T, unsigned LowBits>
+bool tagged_ptr<T, LowBits>::operator!=(const tagged_ptr<T, LowBits>& o) const
 {
     return ptr_.load() != o.ptr_.load();
 }
 
-#if defined(__amd64__) || defined(__x86_64__) || defined(_M_AMD64)
 namespace arch {
-    template<typename T> size_t tag(T* ptr)
+    /// \return the detected layout of user space addresses.
+    inline address_layout detect_addresses()
     {
-        return reinterpret_cast<uintptr_t>(ptr) >> 48;
+#if defined(__linux__) && \
+        (defined(__amd64__) || defined(__x86_64__) || defined(_M_AMD64))
+        // Linux maps above 47 bits only when hinted to and only with 5-level
+        // paging, so probe with a hint there.
+        const long page = sysconf(_SC_PAGESIZE);
+        void* const hint = reinterpret_cast<void*>(uintptr_t(1) << 56);
+        void* const p = mmap(hint, page, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return address_layout(MAX_ADDRESS_BITS);
+        munmap(p, page);
+        if (reinterpret_cast<uintptr_t>(p) >> (DEFAULT_ADDRESS_BITS - 1) != 0)
+            return address_layout(MAX_ADDRESS_BITS);
+#endif
+        return address_layout(DEFAULT_ADDRESS_BITS);
     }
 
-    template<typename T> T* tag(T* ptr, size_t tag)
-    {
-        return reinterpret_cast<T*>(
-                reinterpret_cast<uintptr_t>(untag(ptr)) | (tag << 48));
-    }
+    /// The process wide address layout.
+    ///
+    /// The layout is constant initialized to the widest addresses, valid
+    /// whatever the kernel, then narrowed at startup to those detected.  The
+    /// narrower layout untags the bits of both, so pointers tagged before
+    /// are still untagged correctly, provided no other thread uses them
+    /// meanwhile.  Unlike a function local static, reading it needs no guard
+    /// in every tagged pointer operation.
+    template <typename = void>
+    struct address_holder {
+        static address_layout layout;
+        static const bool detected;
+    };
 
-    template<typename T> T* untag(T* ptr)
-    {
-        return reinterpret_cast<T*>(
-                reinterpret_cast<uintptr_t>(ptr) & ~MASK);
-    }
-}
-#elif defined(__i386__) || defined(_M_IX86) || defined(i386)
-namespace arch {
-    template<typename T> size_t tag(T* ptr)
-    {
-        return reinterpret_cast<uintptr_t>(ptr) & MASK;
-    }
+    template <typename V>
+    address_layout address_holder<V>::layout(MAX_ADDRESS_BITS);
 
-    template<typename T> T* tag(T* ptr, size_t tag)
-    {
-        return reinterpret_cast<T*>(
-                reinterpret_cast<uintptr_t>(untag(ptr)) | (tag & MASK));
-    }
+    template <typename V>
+    const bool address_holder<V>::detected =
+            (address_holder<V>::layout = detect_addresses(), true);
 
-    template<typename T> T* untag(T* ptr)
+    inline const address_layout& addresses()
     {
-        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(ptr) & ~MASK);
+        (void)address_holder<>::detected;
+        return address_holder<>::layout;
     }
+
+    /// Tags of \c LowBits least significant bits, followed by the bits above
+    /// the significant address bits.
+    template <unsigned LowBits>
+    struct layout {
+        static_assert(LowBits < POINTER_BITS / 4, "too many low tag bits");
+
+        constexpr static const uintptr_t LOW_MASK =
+                (uintptr_t(1) << LowBits) - 1;
+
+        static size_t max_tag()
+        {
+            return (size_t(1) << (LowBits + POINTER_BITS -
+                    addresses().bits)) - 1;
+        }
+
+        /// \return \c ptr, asserting it's sufficiently aligned.
+        template<typename T> static T* check(T* ptr)
+        {
+            assert((reinterpret_cast<uintptr_t>(ptr) & LOW_MASK) == 0);
+            return ptr;
+        }
+
+        template<typename T> static size_t tag(T* ptr)
+        {
+            const address_layout& a = addresses();
+            const uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+            return (p & LOW_MASK) |
+                    static_cast<size_t>((uint64_t(p & a.high_mask) >> a.bits)
+                            << LowBits);
+        }
+
+        template<typename T> static T* tag(T* ptr, size_t tag)
+        {
+            static_assert(alignof(T) >= size_t(1) << LowBits,
+                    "T is insufficiently aligned for LowBits");
+            const address_layout& a = addresses();
+            const uintptr_t p = reinterpret_cast<uintptr_t>(ptr) &
+                    ~(a.high_mask | LOW_MASK);
+            return reinterpret_cast<T*>(p | (tag & LOW_MASK) |
+                    (static_cast<uintptr_t>(uint64_t(tag >> LowBits) << a.bits)
+                            & a.high_mask));
+        }
+
+        template<typename T> static T* untag(T* ptr)
+        {
+            return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(ptr) &
+                    ~(addresses().high_mask | LOW_MASK));
+        }
+    };
 }
-#else
-static_assert(false, "unsupported platform");
-#endif
 
 } // namespace mu
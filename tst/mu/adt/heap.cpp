@@ -34,6 +34,22 @@ bool operator<(const noncopyable& lht, const noncopyable& rhs)
     return lht.element_ < rhs.element_;
 }
 
+/// Counts move operations.
+struct counted : noncopyable {
+    static size_t moves_;
+
+    counted(const element& lhs) : noncopyable(lhs) {}
+    counted(counted&& lhs) : noncopyable(move(lhs)) { ++moves_; }
+    counted& operator=(counted&& lhs)
+    {
+        noncopyable::operator=(move(lhs));
+        ++moves_;
+        return *this;
+    }
+};
+
+size_t counted::moves_ = 0;
+
 static void test_emplace()
 {
     heap<noncopyable> h;
@@ -42,6 +58,56 @@ static void test_emplace()
     noncopyable b = std::move(h.top());
 }
 
+static void test_pop_top()
+{
+    heap<noncopyable> h;
+    for (element e : {3, 1, 4, 1, 5, 9, 2, 6}) {
+        h.emplace(noncopyable(e));
+    }
+    for (element e : {1, 1, 2, 3, 4, 5, 6, 9}) {
+        auto popped = h.try_pop();
+        assert(popped);
+        assert(popped->element_ == e);
+    }
+    const auto none = h.try_pop();
+    assert(!none);
+
+    h.emplace(noncopyable(7));
+    const noncopyable top = h.pop_top();
+    assert(top.element_ == 7);
+    assert(h.empty());
+}
+
+/// Verify sifts move each element on the path once rather than swapping.
+static void test_move_count()
+{
+    // A full heap of depth 3, i.e. 7 elements, with minimum 1.
+    heap<counted> h;
+    for (element e = 1; e <= 7; ++e) {
+        h.emplace(counted(e));
+    }
+
+    // Bubbling the new minimum from index 7 to the root shifts 3 parents down.
+    // Expect one move into the heap, one into the temporary, one per shifted
+    // parent and one into the root.  A swap per level would take 1 + 3 * 3.
+    counted::moves_ = 0;
+    h.emplace(counted(0));
+    assert(counted::moves_ == 1 + 1 + 3 + 1);
+
+    // Popping takes the last element, 4, into a temporary, leaving 7 elements.
+    // The lesser child is shifted up at each of the 2 levels down to 4's place
+    // and the temporary is moved into the hole.
+    counted::moves_ = 0;
+    h.pop();
+    assert(counted::moves_ == 1 + 2 + 1);
+    assert(h.top().element_ == 1);
+
+    // An element already in order isn't moved by the sift.
+    counted::moves_ = 0;
+    h.emplace(counted(8));
+    assert(counted::moves_ == 1);
+}
+
 static void test(const vector<element>& es, const vector<element>& expected_order)
 {
     heap<element> h;
@@ -73,6 +139,8 @@ static void tests()
             {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
 
     test_emplace();
+    test_pop_top();
+    test_move_count();
 }
 
 int main(const int, const char** const)
@@ -0,0 +1,88 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <mu/alg/heap.h>
+
+using namespace std;
+namespace heap = mu::alg::heap;
+
+typedef size_t element;
+
+static deque<element> random_elements(size_t n, element max)
+{
+    mt19937_64 generator(n);
+    uniform_int_distribution<element> distribution(0, max);
+    deque<element> es;
+    for (size_t i = 0; i < n; ++i) {
+        es.push_back(distribution(generator));
+    }
+    return es;
+}
+
+static void test_make(size_t n)
+{
+    auto es = random_elements(n, n);
+    heap::make(es);
+    assert(heap::validate(es));
+}
+
+static void test_parallel_make(size_t n, size_t thread_count)
+{
+    auto es = random_elements(n, n);
+    auto expected = es;
+    heap::parallel_make(es, thread_count);
+    assert(heap::validate(es));
+
+    // The result must be a permutation of the input.
+    sort(es.begin(), es.end());
+    sort(expected.begin(), expected.end());
+    assert(es == expected);
+}
+
+static void test_top_n(size_t size, size_t n, size_t thread_count)
+{
+    // Use a small range to exercise duplicates across chunks.
+    auto es = random_elements(size, size / 4);
+    vector<element> expected(es.begin(), es.end());
+    sort(expected.begin(), expected.end());
+    expected.resize(min(n, size));
+
+    const auto top = heap::top_n(es, n, thread_count);
+    assert(top == expected);
+}
+
+static void tests()
+{
+    for (size_t n : {0, 1, 2, 3, 7, 8, 100}) {
+        test_make(n);
+    }
+
+    // Sizes below and above the parallel threshold.
+    for (size_t n : {size_t(0), size_t(1), size_t(100),
+            heap::PARALLEL_MIN_SIZE, heap::PARALLEL_MIN_SIZE * 3 + 17}) {
+        for (size_t t : {1, 2, 3, 8, 64}) {
+            test_parallel_make(n, t);
+        }
+    }
+
+    for (size_t size : {size_t(0), size_t(1), size_t(100),
+            heap::PARALLEL_MIN_SIZE * 2 + 5}) {
+        for (size_t n : {0, 1, 10, 1000}) {
+            for (size_t t : {1, 3, 8}) {
+                test_top_n(size, n, t);
+            }
+        }
+    }
+}
+
+int main(const int, const char** const)
+{
+    tests();
+    return 0;
+}
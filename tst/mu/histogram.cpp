@@ -0,0 +1,160 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <mu/histogram.h>
+
+using namespace std;
+using mu::histogram;
+
+/// \return \c true iff \c actual is within the precision of \c h of \c
+///         expected.
+static bool near(const histogram& h, uint64_t actual, uint64_t expected)
+{
+    const double error = 1.0 / (uint64_t(1) << (h.sub_bucket_bits() - 1));
+    const double difference = actual > expected ?
+            actual - expected : expected - actual;
+    return difference <= expected * error;
+}
+
+static void test_empty()
+{
+    histogram h;
+    assert(h.count() == 0);
+    assert(h.min() == 0);
+    assert(h.max() == 0);
+    assert(h.mean() == 0);
+    assert(h.percentile(50) == 0);
+}
+
+static void test_exact()
+{
+    histogram h;
+    for (uint64_t v = 1; v <= 100; ++v) {
+        h.record(v);
+    }
+    assert(h.count() == 100);
+    assert(h.min() == 1);
+    assert(h.max() == 100);
+    assert(h.mean() == 50.5);
+    assert(h.percentile(0) == 1);
+    assert(h.percentile(50) == 50);
+    assert(h.percentile(99) == 99);
+    assert(h.percentile(100) == 100);
+
+    h.reset();
+    assert(h.count() == 0);
+    assert(h.percentile(50) == 0);
+}
+
+static void test_range(unsigned bits)
+{
+    histogram h(bits);
+    h.record(0);
+    h.record(numeric_limits<uint64_t>::max());
+    assert(h.min() == 0);
+    assert(h.max() == numeric_limits<uint64_t>::max());
+    assert(h.percentile(50) == 0);
+    assert(h.percentile(100) == numeric_limits<uint64_t>::max());
+
+    // Every power of two and its neighbours are reported within precision.
+    for (unsigned shift = 0; shift < 63; ++shift) {
+        for (uint64_t v : {(uint64_t(1) << shift) - 1,
+                uint64_t(1) << shift,
+                (uint64_t(1) << shift) + 1}) {
+            histogram g(bits);
+            g.record(v);
+            g.record(numeric_limits<uint64_t>::max());
+            assert(near(g, g.percentile(50), v));
+        }
+    }
+}
+
+static void test_percentiles(size_t n)
+{
+    mt19937_64 generator(n);
+    exponential_distribution<double> distribution(1e-6);
+    vector<uint64_t> values;
+    histogram h;
+    for (size_t i = 0; i < n; ++i) {
+        values.push_back(static_cast<uint64_t>(distribution(generator)));
+        h.record(values.back());
+    }
+    sort(values.begin(), values.end());
+
+    assert(h.count() == n);
+    assert(h.min() == values.front());
+    assert(h.max() == values.back());
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        const auto rank = static_cast<size_t>(p / 100 * n + 0.5);
+        assert(near(h, h.percentile(p), values[rank - 1]));
+    }
+}
+
+static void test_merge(size_t thread_count, size_t n)
+{
+    vector<histogram*> hs;
+    for (size_t i = 0; i < thread_count; ++i) {
+        hs.push_back(new histogram);
+    }
+    histogram shared;
+
+    // Record concurrently, both into a histogram per thread and a shared one.
+    vector<thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i] {
+            for (size_t j = 0; j < n; ++j) {
+                hs[i]->record(i * n + j);
+                shared.record(i * n + j);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    histogram merged;
+    for (auto h : hs) {
+        merged.merge(*h);
+        delete h;
+    }
+    for (auto h : {&merged, &shared}) {
+        assert(h->count() == thread_count * n);
+        assert(h->min() == 0);
+        assert(h->max() == thread_count * n - 1);
+        for (double p : {50.0, 99.0, 100.0}) {
+            assert(near(*h, h->percentile(p),
+                    static_cast<uint64_t>(p / 100 * thread_count * n) - 1));
+        }
+    }
+}
+
+static void tests()
+{
+    test_empty();
+    test_exact();
+    for (unsigned bits : {histogram::MIN_SUB_BUCKET_BITS, 4u,
+            histogram::DEFAULT_SUB_BUCKET_BITS,
+            histogram::MAX_SUB_BUCKET_BITS}) {
+        test_range(bits);
+    }
+    for (size_t n : {1000, 100000}) {
+        test_percentiles(n);
+    }
+    for (size_t t : {1, 2, 4}) {
+        test_merge(t, 100000);
+    }
+}
+
+int main(const int, const char** const)
+{
+    tests();
+    return 0;
+}
@@ -0,0 +1,74 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+#include <mu/lf/baskets_queue.h>
+
+#include "queue_conformance.h"
+
+using namespace std;
+
+template <typename T> using baskets_queue = mu::lf::baskets_queue<T>;
+
+/// Pops leave a chain of deleted nodes behind the head, freed every few hops,
+/// so pushes and pops after chains of each length up to past the freeing
+/// point see the remaining elements in order, then an empty queue.
+static void test_deleted_chain(size_t max_count)
+{
+    for (size_t pushed = 1; pushed <= max_count; ++pushed) {
+        for (size_t popped = 0; popped <= pushed; ++popped) {
+            baskets_queue<size_t> q(4);
+            size_t e = 0;
+            for (size_t i = 0; i < pushed; ++i) {
+                q.push(i);
+            }
+            for (size_t i = 0; i < popped; ++i) {
+                const bool ok = q.pop(e);
+                assert(ok && e == i);
+            }
+            q.push(pushed);
+            for (size_t i = popped; i <= pushed; ++i) {
+                assert(!q.empty());
+                const bool ok = q.pop(e);
+                assert(ok && e == i);
+            }
+            assert(q.empty());
+            const bool ok = q.pop(e);
+            assert(!ok);
+        }
+    }
+}
+
+/// Popped values may be held by the chain of deleted nodes, which delayed
+/// dequeuers may still be reading, but are released by the destructor.
+static void test_reset(size_t count)
+{
+    auto const p = make_shared<int>(42);
+    {
+        baskets_queue<shared_ptr<int>> q(4);
+        q.push(p);
+        for (size_t i = 1; i < count; ++i) {
+            q.push(make_shared<int>(int(i)));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const bool popped = bool(q.pop());
+            assert(popped);
+        }
+        const bool popped = bool(q.pop());
+        assert(!popped);
+    }
+    assert(p.use_count() == 1);
+}
+
+int main(const int, const char** const)
+{
+    conformance::tests<baskets_queue>();
+    test_deleted_chain(9);
+    for (size_t count = 2; count <= 9; ++count) {
+        test_reset(count);
+    }
+    return 0;
+}
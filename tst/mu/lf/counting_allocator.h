@@ -0,0 +1,51 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+/// Counts live allocations across all rebound instances, throwing
+/// \c std::bad_alloc rather than exceed \c limit.
+template <typename T>
+struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator(long& live, long limit = LONG_MAX) :
+            live_(&live), limit_(limit) {}
+    template <typename U>
+    counting_allocator(const counting_allocator<U>& o) :
+            live_(o.live_), limit_(o.limit_) {}
+
+    T* allocate(size_t n)
+    {
+        if (*live_ == limit_)
+            throw std::bad_alloc();
+        ++*live_;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        --*live_;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    long* live_;
+    long limit_;
+};
+
+template <typename T, typename U>
+bool operator==(const counting_allocator<T>& l, const counting_allocator<U>& r)
+{
+    return l.live_ == r.live_;
+}
+
+template <typename T, typename U>
+bool operator!=(const counting_allocator<T>& l, const counting_allocator<U>& r)
+{
+    return !(l == r);
+}
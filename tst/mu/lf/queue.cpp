@@ -7,6 +7,8 @@
 
 #include <mu/lf/queue.h>
 
+#include "counting_allocator.h"
+
 using namespace std;
 using mu::lf::queue;
 
@@ -90,12 +92,177 @@ void test_capacity_plus_n(size_t const n)
     }
 }
 
+void test_allocator()
+{
+    long live = 0;
+    {
+        queue<foo, counting_allocator<foo>> q(4, counting_allocator<foo>(live));
+        assert(live > 0);
+
+        // Exceed the initial capacity.
+        for (size_t i = 0; i < 16; ++i) {
+            q.push(e_t(i));
+        }
+        for (size_t i = 0; i < 16; ++i) {
+            auto const popped = q.pop();
+            assert(popped);
+            assert(*popped == e_t(i));
+        }
+        assert(q.empty());
+    }
+    assert(live == 0);
+}
+
+void test_trivially_copyable()
+{
+    static_assert(mu::lf::impl::is_trivial_value<size_t>::value, "");
+    static_assert(!mu::lf::impl::is_trivial_value<foo>::value, "");
+
+    queue<size_t> q(4);
+    for (size_t i = 0; i < 16; ++i) {
+        q.push(i);
+    }
+    for (size_t i = 0; i < 16; ++i) {
+        size_t popped = 0;
+        const bool ok = q.pop(popped);
+        assert(ok);
+        assert(popped == i);
+    }
+    assert(q.empty());
+}
+
+/// Popped values may be held by the sentinel or pooled nodes, which delayed
+/// dequeuers may still be reading, but are released by the destructor, even
+/// when it returns the nodes to a slab.
+template <typename Links>
+void test_reset()
+{
+    auto const p = make_shared<int>(42);
+    {
+        queue<shared_ptr<int>, allocator<shared_ptr<int>>, Links> q(4);
+        q.push(p);
+        q.push(make_shared<int>(43));
+        assert(p.use_count() == 2);
+
+        auto popped = q.pop();
+        assert(popped && *popped == p);
+        popped = q.pop();
+        assert(popped && **popped == 43);
+        popped = q.pop();
+        assert(!popped);
+    }
+    assert(p.use_count() == 1);
+}
+
+void test_index_links(size_t const capacity)
+{
+    using indexed = queue<size_t, allocator<size_t>, mu::lf::index_links>;
+
+    // Share the slab between queues, exceeding their capacity concurrently.
+    const size_t thread_count = 4;
+    const size_t n = 4 * capacity;
+    for (size_t round = 0; round < 2; ++round) {
+        indexed a(capacity);
+        indexed b(capacity);
+        vector<thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                indexed& q = t % 2 == 0 ? a : b;
+                for (size_t i = 0; i < n; ++i) {
+                    q.push(t * n + i);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        // Each producer's elements are dequeued in order.
+        vector<size_t> next(thread_count, 0);
+        for (indexed* q : {&a, &b}) {
+            size_t e = 0;
+            while (q->pop(e)) {
+                const size_t t = e / n;
+                assert(e % n == next[t]);
+                ++next[t];
+            }
+            assert(q->empty());
+        }
+        for (size_t t = 0; t < thread_count; ++t) {
+            assert(next[t] == n);
+        }
+    }
+}
+
+void test_aligned_links(size_t const capacity)
+{
+    // Nodes padded to 16 bytes, tagging 4 low bits.
+    using aligned = queue<
+            uint8_t,
+            allocator<uint8_t>,
+            mu::lf::tagged_pointer_links<4>>;
+
+    aligned q(capacity);
+    for (size_t round = 0; round < 3; ++round) {
+        for (size_t i = 0; i < 2 * capacity; ++i) {
+            q.push(static_cast<uint8_t>(i));
+        }
+        uint8_t e = 0;
+        for (size_t i = 0; i < 2 * capacity; ++i) {
+            const bool ok = q.pop(e);
+            assert(ok);
+            assert(e == static_cast<uint8_t>(i));
+        }
+        assert(q.empty());
+    }
+}
+
+void test_provision(mu::lf::provision const p, size_t const capacity)
+{
+    q_t q(capacity, p);
+    assert(q.capacity() == capacity);
+
+    // Exceed the initial capacity, from several threads.
+    const size_t thread_count = 4;
+    const size_t n = capacity;
+    vector<thread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&q, t, n] {
+            for (size_t i = 0; i < n; ++i) {
+                q.push(e_t(t * n + i));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    vector<bool> seen(thread_count * n, false);
+    for (size_t i = 0; i < thread_count * n; ++i) {
+        auto const popped = q.pop();
+        assert(popped);
+        assert(!seen[popped->id_]);
+        seen[popped->id_] = true;
+    }
+    assert(q.empty());
+    assert(q.capacity() >= thread_count * n);
+}
+
 void run_tests()
 {
     test_singleton();
     test_combinations(5);
     test_capacity_plus_n(0);
     test_capacity_plus_n(1);
+    test_allocator();
+    test_trivially_copyable();
+    test_reset<mu::lf::pointer_links>();
+    test_reset<mu::lf::index_links>();
+    test_index_links(1000);
+    test_aligned_links(1000);
+    for (auto p : {mu::lf::provision::eager, mu::lf::provision::parallel,
+            mu::lf::provision::lazy}) {
+        test_provision(p, 100000);
+    }
 }
 
 int main(int const, char const** const)
@@ -0,0 +1,187 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/provision.h>
+
+/// Tests common to the multi-producer multi-consumer queues sharing the
+/// interface of \c mu::lf::queue, instantiated by each queue's tests.
+///
+/// Queues are made by a \c Make functor, \c make(capacity, provision)
+/// returning a \c std::unique_ptr, so that queues taking further constructor
+/// arguments can be tested.
+
+namespace conformance {
+
+/// Make a \c Queue by its (initial capacity, provision) constructor.
+template <typename Queue>
+struct construct {
+    std::unique_ptr<Queue> operator()(
+            size_t capacity,
+            mu::lf::provision p) const
+    {
+        return std::unique_ptr<Queue>(new Queue(capacity, p));
+    }
+};
+
+/// Elements are popped in the order pushed, through rounds exceeding the
+/// capacity, then reusing the nodes.
+///
+/// \tparam Queue of \c std::string.
+template <typename Queue, typename Make = construct<Queue>>
+void test_sequential(size_t capacity, Make make = Make())
+{
+    using std::to_string;
+
+    auto q = make(capacity, mu::lf::provision::eager);
+    assert(q->empty());
+    auto popped = q->pop();
+    assert(!popped);
+
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < 2 * capacity; ++i) {
+            if (i % 2 == 0)
+                q->push(to_string(i));
+            else
+                q->emplace(to_string(i));
+        }
+        assert(!q->empty());
+        for (size_t i = 0; i < 2 * capacity; ++i) {
+            auto e = q->pop();
+            assert(e);
+            assert(*e == to_string(i));
+        }
+        assert(q->empty());
+        popped = q->pop();
+        assert(!popped);
+    }
+}
+
+/// Pops of a drained queue return \c false, whatever the number of elements
+/// drained, from one up to \c max_count, and pushes after them succeed.
+///
+/// \tparam Queue of \c size_t.
+template <typename Queue, typename Make = construct<Queue>>
+void test_drained(size_t max_count, Make make = Make())
+{
+    for (size_t count = 1; count <= max_count; ++count) {
+        auto q = make(4, mu::lf::provision::eager);
+        for (size_t round = 0; round < 2; ++round) {
+            for (size_t i = 0; i < count; ++i) {
+                q->push(i);
+            }
+            size_t e = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const bool popped = q->pop(e);
+                assert(popped);
+            }
+            assert(q->empty());
+            for (size_t i = 0; i < 2; ++i) {
+                const bool popped = q->pop(e);
+                assert(!popped);
+            }
+        }
+    }
+}
+
+/// Producers' elements are each popped once, and in the order each producer
+/// pushed them if \c ordered.  Consumers then poll the drained queue \c
+/// polls times each, which must return.
+///
+/// \tparam Queue of \c size_t.
+template <typename Queue, typename Make = construct<Queue>>
+void test_concurrent(
+        size_t producer_count,
+        size_t consumer_count,
+        size_t n,
+        mu::lf::provision p,
+        bool ordered = true,
+        size_t polls = 0,
+        Make make = Make())
+{
+    auto q = make(n / 2, p);
+    const size_t total = producer_count * n;
+    std::atomic<size_t> remaining(total);
+    std::vector<std::vector<size_t>> popped(consumer_count);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < producer_count; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < n; ++i) {
+                q->push(t * n + i);
+            }
+        });
+    }
+    for (size_t c = 0; c < consumer_count; ++c) {
+        threads.emplace_back([&, c] {
+            size_t e = 0;
+            while (remaining.load() > 0) {
+                if (q->pop(e)) {
+                    popped[c].push_back(e);
+                    --remaining;
+                }
+            }
+            for (size_t i = 0; i < polls; ++i) {
+                const bool polled = q->pop(e);
+                assert(!polled);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(q->empty());
+
+    std::vector<size_t> seen(total, 0);
+    for (const auto& es : popped) {
+        // The least element each producer may have next.
+        std::vector<size_t> next(producer_count);
+        for (size_t t = 0; t < producer_count; ++t) {
+            next[t] = t * n;
+        }
+        for (size_t e : es) {
+            ++seen[e];
+            const size_t t = e / n;
+            assert(!ordered || e >= next[t]);
+            next[t] = e + 1;
+        }
+    }
+    for (size_t s : seen) {
+        assert(s == 1);
+    }
+}
+
+/// Run each test, concurrent ones with eager and lazy provisioning, and
+/// those of order only if \c ordered.
+///
+/// \tparam Queue of the element type.
+/// \tparam Make of \c Queue<std::string> and \c Queue<size_t>.
+template <
+        template <typename> class Queue,
+        template <typename> class Make = construct>
+void tests(bool ordered = true)
+{
+    using mu::lf::provision;
+
+    if (ordered)
+        test_sequential<Queue<std::string>, Make<Queue<std::string>>>(100);
+    test_drained<Queue<size_t>, Make<Queue<size_t>>>(9);
+    for (auto p : {provision::eager, provision::lazy}) {
+        using concurrent = Queue<size_t>;
+        using make = Make<concurrent>;
+        test_concurrent<concurrent, make>(1, 1, 10000, p, ordered);
+        test_concurrent<concurrent, make>(4, 4, 10000, p, ordered);
+        test_concurrent<concurrent, make>(3, 2, 10000, p, ordered);
+        test_concurrent<concurrent, make>(4, 4, 1000, p, ordered, 1000);
+    }
+}
+
+} // namespace conformance
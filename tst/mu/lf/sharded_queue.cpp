@@ -0,0 +1,114 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/sharded_queue.h>
+
+#include "queue_conformance.h"
+
+using namespace std;
+using mu::lf::provision;
+
+template <typename T> using sharded_queue = mu::lf::sharded_queue<T>;
+
+/// Make queues of \c Shards shards.
+template <size_t Shards>
+struct sharded {
+    template <typename Queue>
+    struct make {
+        unique_ptr<Queue> operator()(size_t capacity, provision p) const
+        {
+            return unique_ptr<Queue>(new Queue(capacity, Shards, p));
+        }
+    };
+};
+
+/// Consumers steal from shards other than the hinted one, so every element
+/// is popped whichever shard it was pushed to.
+static void test_stealing(size_t shard_count, size_t n)
+{
+    sharded_queue<size_t> q(n, shard_count, provision::lazy);
+    assert(q.shard_count() == shard_count);
+    assert(q.capacity() >= n);
+    assert(q.local_shard() < shard_count);
+
+    for (size_t i = 0; i < n; ++i) {
+        q.push(i, i);
+    }
+    vector<size_t> popped;
+    size_t e = 0;
+    while (q.pop(e, 0)) {
+        popped.push_back(e);
+    }
+    assert(q.empty());
+    sort(popped.begin(), popped.end());
+    assert(popped.size() == n);
+    for (size_t i = 0; i < n; ++i) {
+        assert(popped[i] == i);
+    }
+}
+
+/// A consumer whose hinted shard stays busy never steals, so an element in
+/// another shard waits, as documented, until hints cover its shard, when
+/// it's popped within a pop per shard.
+static void test_starvation(size_t shard_count, size_t pops)
+{
+    constexpr static const size_t BUSY = 0;
+    constexpr static const size_t WAITING = 1;
+
+    sharded_queue<size_t> q(16, shard_count, provision::eager);
+    const size_t victim = shard_count - 1;
+    q.push(WAITING, victim);
+
+    // Keep shard 0 busy, popping it by hint.
+    size_t e = 0;
+    for (size_t i = 0; i < pops; ++i) {
+        q.push(BUSY, 0);
+        const bool ok = q.pop(e, 0);
+        assert(ok && e == BUSY);
+    }
+    assert(!q.empty());
+
+    // Rotate the hints over the shards, still keeping shard 0 busy.
+    bool popped = false;
+    for (size_t hint = 0; hint < shard_count && !popped; ++hint) {
+        q.push(BUSY, 0);
+        const bool ok = q.pop(e, hint);
+        assert(ok);
+        popped = e == WAITING;
+    }
+    assert(popped);
+
+    while (q.pop(e)) {
+        assert(e == BUSY);
+    }
+}
+
+int main(const int, const char** const)
+{
+    // With one shard the queue is FIFO, with more only each element is
+    // popped once.
+    conformance::tests<sharded_queue, sharded<1>::make>();
+    conformance::tests<sharded_queue, sharded<4>::make>(false);
+    conformance::tests<sharded_queue, sharded<3>::make>(false);
+
+    test_stealing(1, 100);
+    test_stealing(4, 1000);
+    test_starvation(2, 1000);
+    test_starvation(4, 1000);
+
+    // The default shard per CPU.
+    sharded_queue<int> q;
+    assert(q.shard_count() == max<size_t>(1, thread::hardware_concurrency()));
+    q.push(1);
+    int e = 0;
+    const bool ok = q.pop(e);
+    assert(ok && e == 1);
+    return 0;
+}
@@ -0,0 +1,279 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/stack.h>
+
+#include "counting_allocator.h"
+
+using namespace std;
+using mu::lf::stack;
+
+void test_singleton()
+{
+    stack<string> s;
+    assert(s.empty());
+    auto popped = s.pop();
+    assert(!popped);
+
+    s.push("42");
+    popped = s.pop();
+    assert(popped);
+    assert(*popped == "42");
+    assert(s.empty());
+}
+
+/// Elements are popped last in, first out, through rounds exceeding the
+/// capacity, then reusing the nodes.
+void test_lifo(size_t const capacity)
+{
+    stack<string> s(capacity);
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < 2 * capacity; ++i) {
+            if (i % 2 == 0)
+                s.push(to_string(i));
+            else
+                s.emplace(to_string(i));
+        }
+        assert(!s.empty());
+        for (size_t i = 2 * capacity; i-- > 0; ) {
+            string e;
+            if (i % 2 == 0) {
+                const bool ok = s.pop(e);
+                assert(ok);
+            } else {
+                auto const popped = s.pop();
+                assert(popped);
+                e = *popped;
+            }
+            assert(e == to_string(i));
+        }
+        assert(s.empty());
+        auto const popped = s.pop();
+        assert(!popped);
+    }
+}
+
+/// Popped nodes return to the free list for reuse, so rounds exceeding the
+/// capacity allocate no more than the first, and all are freed.
+void test_allocator()
+{
+    long live = 0;
+    {
+        stack<string, counting_allocator<string>> s(
+                4, counting_allocator<string>(live));
+        assert(live == 4);
+
+        long high_water = 0;
+        for (size_t round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < 16; ++i) {
+                s.push(to_string(i));
+            }
+            for (size_t i = 16; i-- > 0; ) {
+                auto const popped = s.pop();
+                assert(popped);
+                assert(*popped == to_string(i));
+            }
+            assert(s.empty());
+            assert(round == 0 || live == high_water);
+            high_water = live;
+        }
+        assert(high_water == 16);
+    }
+    assert(live == 0);
+}
+
+/// Trivially copyable values are copied as bytes, through rounds reusing the
+/// uninitialized nodes.
+void test_trivially_copyable()
+{
+    static_assert(mu::lf::impl::is_trivial_value<size_t>::value, "");
+    static_assert(!mu::lf::impl::is_trivial_value<string>::value, "");
+
+    stack<size_t> s(4);
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < 16; ++i) {
+            s.push(i);
+        }
+        for (size_t i = 16; i-- > 0; ) {
+            size_t popped = 0;
+            const bool ok = s.pop(popped);
+            assert(ok);
+            assert(popped == i);
+        }
+        assert(s.empty());
+    }
+}
+
+/// Other values are reset when popped, so that pooled nodes hold no
+/// resources.
+void test_reset()
+{
+    stack<shared_ptr<int>> s(4);
+    auto const p = make_shared<int>(42);
+    s.push(p);
+    s.emplace(shared_ptr<int>(p));
+    assert(p.use_count() == 3);
+
+    shared_ptr<int> out;
+    const bool ok = s.pop(out);
+    assert(ok);
+    assert(out == p);
+    assert(p.use_count() == 3);
+    out.reset();
+    assert(p.use_count() == 2);
+
+    auto popped = s.pop();
+    assert(popped && *popped == p);
+    popped = mu::optional<shared_ptr<int>>();
+    assert(p.use_count() == 1);
+}
+
+/// Stacks of nodes linked by slab indices share the slab, exceeding their
+/// capacity concurrently, and each producer's elements are popped in the
+/// reverse of the order pushed.
+void test_index_links(size_t const capacity)
+{
+    using indexed = stack<size_t, allocator<size_t>, mu::lf::index_links>;
+
+    const size_t thread_count = 4;
+    const size_t n = 4 * capacity;
+    for (size_t round = 0; round < 2; ++round) {
+        indexed a(capacity);
+        indexed b(capacity);
+        vector<thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                indexed& s = t % 2 == 0 ? a : b;
+                for (size_t i = 0; i < n; ++i) {
+                    s.push(t * n + i);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        // The number of each producer's elements yet to be popped.
+        vector<size_t> remaining(thread_count, n);
+        for (indexed* s : {&a, &b}) {
+            size_t e = 0;
+            while (s->pop(e)) {
+                const size_t t = e / n;
+                assert(e % n == remaining[t] - 1);
+                --remaining[t];
+            }
+            assert(s->empty());
+        }
+        for (size_t t = 0; t < thread_count; ++t) {
+            assert(remaining[t] == 0);
+        }
+    }
+}
+
+/// Eager and parallel provisioning allocate the capacity on construction,
+/// lazy provisioning in batches as the free list is exhausted.
+void test_provision_allocations(mu::lf::provision const p)
+{
+    using mu::lf::impl::LAZY_BATCH;
+
+    const size_t capacity = 2 * LAZY_BATCH + 1;
+    long live = 0;
+    {
+        stack<size_t, counting_allocator<size_t>> s(
+                capacity, p, counting_allocator<size_t>(live));
+        const bool lazy = p == mu::lf::provision::lazy;
+        assert(live == (lazy ? 0 : long(capacity)));
+
+        s.push(0);
+        assert(live == long(lazy ? LAZY_BATCH : capacity));
+        for (size_t i = 1; i < capacity; ++i) {
+            s.push(i);
+        }
+        assert(live == long(capacity));
+
+        // Beyond the capacity, nodes are allocated individually.
+        s.push(capacity);
+        assert(live == long(capacity + 1));
+
+        size_t e = 0;
+        while (s.pop(e)) {
+        }
+    }
+    assert(live == 0);
+}
+
+/// A constructor failing to provision its capacity frees the nodes it did
+/// and rethrows.
+void test_provision_failure(mu::lf::provision const p)
+{
+    long live = 0;
+    try {
+        stack<size_t, counting_allocator<size_t>> s(
+                100, p, counting_allocator<size_t>(live, 50));
+        assert(false);
+    } catch (const bad_alloc&) {
+    }
+    assert(live == 0);
+}
+
+/// Threads together exceed the initial capacity, each element popped once.
+void test_provision(mu::lf::provision const p, size_t const capacity)
+{
+    stack<size_t> s(capacity, p);
+
+    const size_t thread_count = 4;
+    const size_t n = capacity;
+    vector<thread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&s, t, n] {
+            for (size_t i = 0; i < n; ++i) {
+                s.push(t * n + i);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    vector<bool> seen(thread_count * n, false);
+    for (size_t i = 0; i < thread_count * n; ++i) {
+        size_t e = 0;
+        const bool ok = s.pop(e);
+        assert(ok);
+        assert(!seen[e]);
+        seen[e] = true;
+    }
+    assert(s.empty());
+}
+
+void run_tests()
+{
+    test_singleton();
+    test_lifo(1);
+    test_lifo(100);
+    test_allocator();
+    test_trivially_copyable();
+    test_reset();
+    test_index_links(1000);
+    for (auto p : {mu::lf::provision::eager, mu::lf::provision::parallel,
+            mu::lf::provision::lazy}) {
+        test_provision_allocations(p);
+        test_provision(p, 100000);
+    }
+    for (auto p : {mu::lf::provision::eager, mu::lf::provision::parallel}) {
+        test_provision_failure(p);
+    }
+}
+
+int main(int const, char const** const)
+{
+    run_tests();
+    return 0;
+}
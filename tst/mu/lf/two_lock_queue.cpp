@@ -0,0 +1,68 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/two_lock_queue.h>
+#include <mu/spinlock.h>
+
+#include "queue_conformance.h"
+
+using namespace std;
+using mu::lf::two_lock_queue;
+
+/// Threads increment a counter guarded by \c Lock non-atomically.
+template <typename Lock>
+void test_mutual_exclusion(size_t thread_count, size_t n)
+{
+    Lock lock;
+    size_t count = 0;
+    vector<thread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < n; ++i) {
+                typename Lock::guard _(lock);
+                const size_t c = count;
+                count = c + 1;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(count == thread_count * n);
+}
+
+/// Nodes are reused once popped, so capacity grows only to the most held.
+template <typename Lock>
+void test_capacity(size_t capacity)
+{
+    two_lock_queue<size_t, Lock> q(capacity);
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < 2 * capacity; ++i) {
+            q.push(i);
+        }
+        size_t e = 0;
+        while (q.pop(e)) {
+        }
+        assert(q.capacity() == 2 * capacity + 1);
+    }
+}
+
+template <typename T> using ticket_queue = two_lock_queue<T>;
+template <typename T>
+using mcs_queue = two_lock_queue<T, mu::mcs_spinlock>;
+
+int main(const int, const char** const)
+{
+    test_mutual_exclusion<mu::ticket_spinlock>(4, 100000);
+    test_mutual_exclusion<mu::mcs_spinlock>(4, 100000);
+    test_capacity<mu::ticket_spinlock>(100);
+    test_capacity<mu::mcs_spinlock>(100);
+    conformance::tests<ticket_queue>();
+    conformance::tests<mcs_queue>();
+    return 0;
+}
@@ -0,0 +1,77 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <mu/lf/impl/thread_slot.h>
+#include <mu/lf/wait_free_queue.h>
+
+#include "queue_conformance.h"
+
+using namespace std;
+using mu::lf::impl::thread_slots;
+using mu::lf::wait_free_queue;
+
+template <typename T> using fast_queue = wait_free_queue<T>;
+
+/// Queues announcing every operation, exercising the helping slow path.
+template <typename T>
+using slow_queue = wait_free_queue<T, allocator<T>, 0>;
+
+/// Batches of threads, in all several times the slots, each push two elements
+/// and pop one, leaving the other to later threads.  Exited threads' slots,
+/// with the announcements they left, are reused, without exhausting the
+/// slots, and every element is popped once.
+template <template <typename> class Queue>
+void test_slot_reuse(size_t batch_size)
+{
+    const size_t thread_count = 2 * thread_slots::MAX_SLOTS;
+    const size_t high_water = thread_slots::instance().high_water();
+    vector<size_t> seen(2 * thread_count, 0);
+    Queue<size_t> q(16);
+    for (size_t b = 0; b < thread_count / batch_size; ++b) {
+        vector<thread> threads;
+        vector<size_t> popped(batch_size);
+        for (size_t t = 0; t < batch_size; ++t) {
+            const size_t id = b * batch_size + t;
+            threads.emplace_back([&, id, t] {
+                q.push(2 * id);
+                q.push(2 * id + 1);
+                const bool ok = q.pop(popped[t]);
+                assert(ok);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (size_t e : popped) {
+            ++seen[e];
+        }
+    }
+    assert(thread_slots::instance().high_water() <= high_water + batch_size);
+
+    size_t e = 0;
+    while (q.pop(e)) {
+        ++seen[e];
+    }
+    for (size_t s : seen) {
+        assert(s == 1);
+    }
+}
+
+int main(const int, const char** const)
+{
+    conformance::tests<fast_queue>();
+    conformance::tests<slow_queue>();
+
+    // Many threads helping each other's announced operations on both ends.
+    conformance::test_concurrent<slow_queue<size_t>>(
+            32, 32, 1000, mu::lf::provision::eager);
+    test_slot_reuse<fast_queue>(8);
+    test_slot_reuse<slow_queue>(8);
+    return 0;
+}
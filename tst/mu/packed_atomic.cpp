@@ -0,0 +1,125 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <mu/packed_atomic.h>
+
+using namespace std;
+using mu::field;
+using mu::packed;
+using mu::packed_atomic;
+
+enum class state : uint8_t { idle, busy, done };
+
+/// An (index, version, flags) tuple.
+using slot = packed<
+        field<uint32_t, 32>,
+        field<uint32_t, 24>,
+        field<state, 2>,
+        field<bool, 1>>;
+
+// Accessors are constant expressions.
+static_assert(slot().bits() == 0, "");
+static_assert(slot(1, 2, state::done, true).get<0>() == 1, "");
+static_assert(slot(1, 2, state::done, true).get<1>() == 2, "");
+static_assert(slot(1, 2, state::done, true).get<2>() == state::done, "");
+static_assert(slot(1, 2, state::done, true).get<3>(), "");
+static_assert(slot(1, 2, state::done, true).bits() ==
+        (uint64_t(1) | uint64_t(2) << 32 | uint64_t(2) << 56 |
+                uint64_t(1) << 58), "");
+static_assert(slot(0, 0xffffff, state::idle, false).set<1>(0x1000000).get<1>()
+        == 0, "fields wrap");
+static_assert(slot::from_bits(slot(7, 8, state::busy, false).bits()) ==
+        slot(7, 8, state::busy, false), "");
+
+static void test_fields()
+{
+    slot s(0xffff'ffff, 0xff'ffff, state::busy, true);
+    assert(s.get<0>() == 0xffff'ffff);
+    assert(s.get<1>() == 0xff'ffff);
+    assert(s.get<2>() == state::busy);
+    assert(s.get<3>());
+
+    // Setting a field leaves the others.
+    s = s.set<1>(5);
+    assert(s.get<0>() == 0xffff'ffff);
+    assert(s.get<1>() == 5);
+    assert(s.get<2>() == state::busy);
+    assert(s.get<3>());
+    s = s.set<3>(false);
+    assert(!s.get<3>());
+    assert(s.get<2>() == state::busy);
+
+    // Pointers whose significant bits fit.
+    int i = 0;
+    using tagged = packed<field<int*, 48>, field<uint16_t, 16>>;
+    const tagged t(&i, 0xffff);
+    assert(t.get<0>() == &i);
+    assert(t.get<1>() == 0xffff);
+    assert(t.set<1>(t.get<1>() + 1).get<1>() == 0);
+    assert(t.set<1>(t.get<1>() + 1).get<0>() == &i);
+}
+
+static void test_atomic()
+{
+    packed_atomic<field<uint32_t, 32>, field<uint32_t, 32>> a;
+    assert(a.is_lock_free());
+    using value = decltype(a)::value;
+    assert(a.load() == value());
+
+    a.store(value(1, 2));
+    value expected(1, 3);
+    bool exchanged = a.compare_exchange_strong(expected, value(4, 5));
+    assert(!exchanged);
+    assert(expected == value(1, 2));
+    exchanged = a.compare_exchange_strong(expected, value(4, 5));
+    assert(exchanged);
+    assert(a.load() == value(4, 5));
+
+    const value previous = a.fetch_update([](value v) {
+        return v.set<1>(v.get<1>() + 1);
+    });
+    assert(previous == value(4, 5));
+    assert(a.load() == value(4, 6));
+}
+
+static void test_fetch_update(size_t thread_count, size_t n)
+{
+    // Concurrently increment a narrow counter, wrapping, and a wide one.
+    packed_atomic<field<uint32_t, 8>, field<uint64_t, 56>> a;
+    using value = decltype(a)::value;
+    vector<thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&a, n] {
+            for (size_t j = 0; j < n; ++j) {
+                a.fetch_update([](value v) {
+                    return value(v.get<0>() + 1, v.get<1>() + 1);
+                });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(a.load().get<0>() == (thread_count * n) % 256);
+    assert(a.load().get<1>() == thread_count * n);
+}
+
+static void tests()
+{
+    test_fields();
+    test_atomic();
+    for (size_t t : {1, 2, 4}) {
+        test_fetch_update(t, 100000);
+    }
+}
+
+int main(const int, const char** const)
+{
+    tests();
+    return 0;
+}
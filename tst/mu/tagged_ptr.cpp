@@ -0,0 +1,85 @@
+// vim: set ts=4 sw=4 tw=80 expandtab
+// Copyright 2015 Migrant Coder
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <mu/tagged_ptr.h>
+
+using namespace std;
+using mu::tagged_ptr;
+
+struct alignas(16) aligned {
+    size_t value;
+};
+
+static void test_address_layout()
+{
+    const auto& a = mu::arch::addresses();
+    assert(a.bits == 48 || a.bits == 57);
+    assert(a.high_mask == ~uintptr_t(0) << a.bits);
+    assert(tagged_ptr<size_t>::max_tag() ==
+            (size_t(1) << (64 - a.bits)) - 1);
+    assert((tagged_ptr<aligned, 4>::max_tag()) ==
+            (size_t(1) << (68 - a.bits)) - 1);
+}
+
+template <unsigned LowBits>
+static void test_tags()
+{
+    using ptr = tagged_ptr<aligned, LowBits>;
+    using value = typename ptr::value;
+
+    aligned x{7};
+    ptr p(&x);
+    assert(p.get_tag() == 0);
+    assert(static_cast<aligned*>(p) == &x);
+
+    // Tags count through the low and high bits without disturbing the
+    // pointer, then wrap.
+    value v = p.load();
+    for (size_t tag = 1; tag <= ptr::max_tag(); ++tag) {
+        v = v.increment_tag();
+        assert(v.get_tag() == tag);
+        assert(static_cast<aligned*>(v) == &x);
+    }
+    assert(v->value == 7);
+    const bool set = p.compare_set_strong(p.load(), v);
+    assert(set);
+    assert(p.get_tag() == ptr::max_tag());
+    assert(p.increment_tag().get_tag() == 0);
+    assert(&*p.increment_tag() == &x);
+
+    // Tags are copied between pointers.
+    aligned y{8};
+    const value w = value(&y).set_tag(v);
+    assert(w.get_tag() == ptr::max_tag());
+    assert(w->value == 8);
+    assert(w != v);
+    assert(!value());
+}
+
+/// The default tags pointers to objects of any alignment, e.g. into a buffer.
+template <typename T>
+static void test_default_alignment()
+{
+    T buffer[3] = {T(1), T(2), T(3)};
+    tagged_ptr<T> p(&buffer[1]);
+    const auto v = p.load().increment_tag();
+    const bool set = p.compare_set_strong(p.load(), v);
+    assert(set);
+    assert(p.get_tag() == (tagged_ptr<T>::max_tag() > 0 ? 1 : 0));
+    assert(*p == T(2));
+}
+
+int main(const int, const char** const)
+{
+    test_address_layout();
+    test_default_alignment<char>();
+    test_default_alignment<uint16_t>();
+    test_default_alignment<uint32_t>();
+    test_tags<0>();
+    test_tags<4>();
+    return 0;
+}